@@ -37,6 +37,9 @@ void* b2StackAllocator::Allocate(int32 size)
 {
 	b2Assert(m_entryCount < b2_maxStackEntries);
 
+	// Keep every entry aligned for the pointer arrays that follow odd sized ones.
+	size = (size + sizeof(void*) - 1) & ~int32(sizeof(void*) - 1);
+
 	b2StackEntry* entry = m_entries + m_entryCount;
 	entry->size = size;
 	if (m_index + size > b2_stackSize)
@@ -80,7 +80,8 @@ float32 b2Timer::GetMilliseconds() const
 {
     timeval t;
     gettimeofday(&t, 0);
-    return 1000.0f * (t.tv_sec - m_start_sec) + 0.001f * (t.tv_usec - m_start_usec);
+    // Signed, or the microseconds wrap round whenever they are below the start
+    return 1000.0f * (long(t.tv_sec) - long(m_start_sec)) + 0.001f * (long(t.tv_usec) - long(m_start_usec));
 }
 
 #else
@@ -189,6 +189,12 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	// Update in two halves. UpdateManifold only writes to this contact, so
+	// different contacts can run it at the same time. It returns whether
+	// the shapes touch. FinishUpdate wakes the bodies and calls the listener.
+	bool UpdateManifold(b2Manifold* oldManifold);
+	void FinishUpdate(const b2Manifold& oldManifold, bool touching, b2ContactListener* listener);
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
@@ -23,6 +23,7 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Common/b2StackAllocator.h>
+#include <memory.h>
 
 #define B2_DEBUG_SOLVER 0
 
@@ -41,6 +42,71 @@ struct b2ContactPositionConstraint
 	int32 pointCount;
 };
 
+// Four lanes of float32 for the wide solver. Comparisons give masks
+// for b2SelectW.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128 b2FloatW;
+
+inline b2FloatW b2LoadW(const float32* a) { return _mm_loadu_ps(a); }
+inline void b2StoreW(float32* a, b2FloatW b) { _mm_storeu_ps(a, b); }
+inline b2FloatW b2SplatW(float32 a) { return _mm_set1_ps(a); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm_mul_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm_max_ps(a, b); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm_cmpge_ps(a, b); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return _mm_and_ps(a, b); }
+inline b2FloatW b2SelectW(b2FloatW mask, b2FloatW a, b2FloatW b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+#else
+
+struct b2FloatW
+{
+	float32 x[4];
+};
+
+#define B2_LANES(expr) b2FloatW r; for (int32 i = 0; i < 4; ++i) { r.x[i] = (expr); } return r
+
+inline b2FloatW b2LoadW(const float32* a) { B2_LANES(a[i]); }
+inline void b2StoreW(float32* a, b2FloatW b) { for (int32 i = 0; i < 4; ++i) { a[i] = b.x[i]; } }
+inline b2FloatW b2SplatW(float32 a) { B2_LANES(a); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { B2_LANES(a.x[i] + b.x[i]); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { B2_LANES(a.x[i] - b.x[i]); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { B2_LANES(a.x[i] * b.x[i]); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { B2_LANES(b2Min(a.x[i], b.x[i])); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { B2_LANES(b2Max(a.x[i], b.x[i])); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { B2_LANES(a.x[i] >= b.x[i] ? 1.0f : 0.0f); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { B2_LANES(a.x[i] != 0.0f && b.x[i] != 0.0f ? 1.0f : 0.0f); }
+inline b2FloatW b2SelectW(b2FloatW mask, b2FloatW a, b2FloatW b) { B2_LANES(mask.x[i] != 0.0f ? a.x[i] : b.x[i]); }
+
+#undef B2_LANES
+
+#endif
+
+// Four velocity constraints that share no moving body, lane by lane.
+// Unused lanes have no constraint, index -1 and zero mass.
+struct b2ContactConstraintW
+{
+	int32 constraint[4];
+	int32 indexA[4], indexB[4];
+	float32 normalX[4], normalY[4];
+	float32 friction[4], tangentSpeed[4];
+	float32 invMassA[4], invIA[4], invMassB[4], invIB[4];
+	float32 rAx[b2_maxManifoldPoints][4], rAy[b2_maxManifoldPoints][4];
+	float32 rBx[b2_maxManifoldPoints][4], rBy[b2_maxManifoldPoints][4];
+	float32 normalMass[b2_maxManifoldPoints][4], tangentMass[b2_maxManifoldPoints][4];
+	float32 velocityBias[b2_maxManifoldPoints][4];
+	float32 normalImpulse[b2_maxManifoldPoints][4], tangentImpulse[b2_maxManifoldPoints][4];
+	float32 K11[4], K12[4], K21[4], K22[4];	// K.ex.x, K.ex.y, K.ey.x, K.ey.y
+	float32 N11[4], N12[4], N21[4], N22[4];	// normalMass, laid out the same way
+};
+
+// Contacts under this count aren't worth batching.
+const int32 b2_minWideContacts = 8;
+
 b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -51,6 +117,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_wideConstraints = NULL;
+	m_wideCount = 0;
+	m_wideTwoPointCount = 0;
+	m_leftovers = NULL;
+	m_leftoverCount = 0;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -130,6 +201,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_wideConstraints)
+	{
+		m_allocator->Free(m_wideConstraints);
+		m_allocator->Free(m_leftovers);
+	}
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -244,6 +320,11 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+	if (m_step.wideContacts)
+	{
+		PrepareWide();
+	}
 }
 
 void b2ContactSolver::WarmStart()
@@ -288,9 +369,19 @@ void b2ContactSolver::WarmStart()
 
 void b2ContactSolver::SolveVelocityConstraints()
 {
-	for (int32 i = 0; i < m_count; ++i)
+	// The wide batches leave some constraints over for the scalar loop
+	int32 count = m_count;
+	const int32* order = NULL;
+	if (m_leftovers)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		SolveWideVelocityConstraints();
+		count = m_leftoverCount;
+		order = m_leftovers;
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + (order ? order[i] : i);
 
 		int32 indexA = vc->indexA;
 		int32 indexB = vc->indexB;
@@ -598,6 +689,26 @@ void b2ContactSolver::SolveVelocityConstraints()
 
 void b2ContactSolver::StoreImpulses()
 {
+	// The wide solver keeps its impulses in its batches until now
+	for (int32 n = 0; n < m_wideCount; ++n)
+	{
+		const b2ContactConstraintW* wc = m_wideConstraints + n;
+		for (int32 lane = 0; lane < 4; ++lane)
+		{
+			if (wc->constraint[lane] < 0)
+			{
+				continue;
+			}
+
+			b2ContactVelocityConstraint* vc = m_velocityConstraints + wc->constraint[lane];
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = wc->normalImpulse[j][lane];
+				vc->points[j].tangentImpulse = wc->tangentImpulse[j][lane];
+			}
+		}
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -611,6 +722,385 @@ void b2ContactSolver::StoreImpulses()
 	}
 }
 
+// Greedily colours the constraints into batches of four that share no
+// moving body, the 2 point constraints first. Up to 32 batches are filled
+// at once. A constraint that clashes with all of them is left over and
+// solved on its own after the batches.
+void b2ContactSolver::PrepareWide()
+{
+	if (m_count < b2_minWideContacts)
+	{
+		return;
+	}
+
+	int32 bodyCount = 0;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		bodyCount = b2Max(bodyCount, b2Max(m_velocityConstraints[i].indexA, m_velocityConstraints[i].indexB) + 1);
+	}
+
+	// Batch * 4 + lane of each constraint, or -1. Reused for the leftovers.
+	int32* slots = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	uint32* bodyBatches = (uint32*)m_allocator->Allocate(bodyCount * sizeof(uint32));
+
+	int32 batchCount = 0;
+	for (int32 pointCount = 2; pointCount >= 1; --pointCount)
+	{
+		memset(bodyBatches, 0, bodyCount * sizeof(uint32));
+		uint32 open = 0;
+		int32 openBatch[32];
+		int32 openLanes[32];
+		int32 openBodies[32][8];
+
+		for (int32 i = 0; i < m_count; ++i)
+		{
+			const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+			if (vc->pointCount != pointCount)
+			{
+				continue;
+			}
+
+			// Static and kinematic bodies aren't changed by the solver, so
+			// any number of lanes can share them.
+			bool movesA = vc->invMassA != 0.0f || vc->invIA != 0.0f;
+			bool movesB = vc->invMassB != 0.0f || vc->invIB != 0.0f;
+			uint32 clash = (movesA ? bodyBatches[vc->indexA] : 0) | (movesB ? bodyBatches[vc->indexB] : 0);
+
+			int32 slot = 0;
+			uint32 free = open & ~clash;
+			if (free == 0)
+			{
+				free = ~open;
+				if (free == 0)
+				{
+					slots[i] = -1;
+					continue;
+				}
+
+				// Start a new batch.
+				while ((free >> slot & 1) == 0)
+				{
+					++slot;
+				}
+				open |= uint32(1) << slot;
+				openBatch[slot] = batchCount++;
+				openLanes[slot] = 0;
+			}
+			else
+			{
+				while ((free >> slot & 1) == 0)
+				{
+					++slot;
+				}
+			}
+
+			uint32 bit = uint32(1) << slot;
+			int32 lane = openLanes[slot]++;
+			slots[i] = openBatch[slot] * 4 + lane;
+			openBodies[slot][2 * lane + 0] = movesA ? vc->indexA : -1;
+			openBodies[slot][2 * lane + 1] = movesB ? vc->indexB : -1;
+			if (movesA)
+			{
+				bodyBatches[vc->indexA] |= bit;
+			}
+			if (movesB)
+			{
+				bodyBatches[vc->indexB] |= bit;
+			}
+
+			// A full batch frees its slot and its bodies.
+			if (openLanes[slot] == 4)
+			{
+				open &= ~bit;
+				for (int32 k = 0; k < 8; ++k)
+				{
+					if (openBodies[slot][k] >= 0)
+					{
+						bodyBatches[openBodies[slot][k]] &= ~bit;
+					}
+				}
+			}
+		}
+
+		if (pointCount == 2)
+		{
+			m_wideTwoPointCount = batchCount;
+		}
+	}
+
+	m_allocator->Free(bodyBatches);
+
+	m_wideCount = batchCount;
+	m_wideConstraints = (b2ContactConstraintW*)m_allocator->Allocate(m_wideCount * sizeof(b2ContactConstraintW));
+	memset(m_wideConstraints, 0, m_wideCount * sizeof(b2ContactConstraintW));
+	for (int32 n = 0; n < m_wideCount; ++n)
+	{
+		for (int32 lane = 0; lane < 4; ++lane)
+		{
+			m_wideConstraints[n].constraint[lane] = -1;
+			m_wideConstraints[n].indexA[lane] = -1;
+			m_wideConstraints[n].indexB[lane] = -1;
+		}
+	}
+
+	m_leftovers = slots;
+	m_leftoverCount = 0;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		int32 slot = slots[i];
+		if (slot < 0)
+		{
+			m_leftovers[m_leftoverCount++] = i;
+			continue;
+		}
+
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2ContactConstraintW* wc = m_wideConstraints + slot / 4;
+		int32 lane = slot % 4;
+		wc->constraint[lane] = i;
+		wc->indexA[lane] = vc->indexA;
+		wc->indexB[lane] = vc->indexB;
+		wc->normalX[lane] = vc->normal.x;
+		wc->normalY[lane] = vc->normal.y;
+		wc->friction[lane] = vc->friction;
+		wc->tangentSpeed[lane] = vc->tangentSpeed;
+		wc->invMassA[lane] = vc->invMassA;
+		wc->invIA[lane] = vc->invIA;
+		wc->invMassB[lane] = vc->invMassB;
+		wc->invIB[lane] = vc->invIB;
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			const b2VelocityConstraintPoint* vcp = vc->points + j;
+			wc->rAx[j][lane] = vcp->rA.x;
+			wc->rAy[j][lane] = vcp->rA.y;
+			wc->rBx[j][lane] = vcp->rB.x;
+			wc->rBy[j][lane] = vcp->rB.y;
+			wc->normalMass[j][lane] = vcp->normalMass;
+			wc->tangentMass[j][lane] = vcp->tangentMass;
+			wc->velocityBias[j][lane] = vcp->velocityBias;
+			wc->normalImpulse[j][lane] = vcp->normalImpulse;
+			wc->tangentImpulse[j][lane] = vcp->tangentImpulse;
+		}
+		wc->K11[lane] = vc->K.ex.x;
+		wc->K12[lane] = vc->K.ex.y;
+		wc->K21[lane] = vc->K.ey.x;
+		wc->K22[lane] = vc->K.ey.y;
+		wc->N11[lane] = vc->normalMass.ex.x;
+		wc->N12[lane] = vc->normalMass.ex.y;
+		wc->N21[lane] = vc->normalMass.ey.x;
+		wc->N22[lane] = vc->normalMass.ey.y;
+	}
+}
+
+// SolveVelocityConstraint on each lane of each batch. The lanes of a batch
+// share no moving body, so they can all read their velocities first and
+// write them back after.
+void b2ContactSolver::SolveWideVelocityConstraints()
+{
+	const b2FloatW zero = b2SplatW(0.0f);
+
+	for (int32 n = 0; n < m_wideCount; ++n)
+	{
+		b2ContactConstraintW* wc = m_wideConstraints + n;
+		int32 pointCount = n < m_wideTwoPointCount ? 2 : 1;
+
+		float32 gather[6][4];
+		for (int32 lane = 0; lane < 4; ++lane)
+		{
+			b2Velocity velA, velB;
+			velA.v.SetZero();
+			velA.w = 0.0f;
+			velB = velA;
+			if (wc->indexA[lane] >= 0)
+			{
+				velA = m_velocities[wc->indexA[lane]];
+			}
+			if (wc->indexB[lane] >= 0)
+			{
+				velB = m_velocities[wc->indexB[lane]];
+			}
+			gather[0][lane] = velA.v.x;
+			gather[1][lane] = velA.v.y;
+			gather[2][lane] = velA.w;
+			gather[3][lane] = velB.v.x;
+			gather[4][lane] = velB.v.y;
+			gather[5][lane] = velB.w;
+		}
+
+		b2FloatW vAx = b2LoadW(gather[0]), vAy = b2LoadW(gather[1]), wA = b2LoadW(gather[2]);
+		b2FloatW vBx = b2LoadW(gather[3]), vBy = b2LoadW(gather[4]), wB = b2LoadW(gather[5]);
+
+		b2FloatW mA = b2LoadW(wc->invMassA), iA = b2LoadW(wc->invIA);
+		b2FloatW mB = b2LoadW(wc->invMassB), iB = b2LoadW(wc->invIB);
+		b2FloatW nx = b2LoadW(wc->normalX), ny = b2LoadW(wc->normalY);
+		b2FloatW tx = ny, ty = b2SubW(zero, nx);
+		b2FloatW friction = b2LoadW(wc->friction);
+		b2FloatW tangentSpeed = b2LoadW(wc->tangentSpeed);
+
+		b2FloatW rAx[b2_maxManifoldPoints], rAy[b2_maxManifoldPoints];
+		b2FloatW rBx[b2_maxManifoldPoints], rBy[b2_maxManifoldPoints];
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			rAx[j] = b2LoadW(wc->rAx[j]);
+			rAy[j] = b2LoadW(wc->rAy[j]);
+			rBx[j] = b2LoadW(wc->rBx[j]);
+			rBy[j] = b2LoadW(wc->rBy[j]);
+		}
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			// Relative velocity at contact
+			b2FloatW dvx = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rBy[j])), vAx), b2MulW(wA, rAy[j]));
+			b2FloatW dvy = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rBx[j])), vAy), b2MulW(wA, rAx[j]));
+
+			// Compute tangent force
+			b2FloatW vt = b2SubW(b2AddW(b2MulW(dvx, tx), b2MulW(dvy, ty)), tangentSpeed);
+			b2FloatW lambda = b2MulW(b2LoadW(wc->tangentMass[j]), b2SubW(zero, vt));
+
+			// Clamp the accumulated force
+			b2FloatW oldImpulse = b2LoadW(wc->tangentImpulse[j]);
+			b2FloatW maxFriction = b2MulW(friction, b2LoadW(wc->normalImpulse[j]));
+			b2FloatW newImpulse = b2MaxW(b2SubW(zero, maxFriction), b2MinW(b2AddW(oldImpulse, lambda), maxFriction));
+			lambda = b2SubW(newImpulse, oldImpulse);
+			b2StoreW(wc->tangentImpulse[j], newImpulse);
+
+			// Apply contact impulse
+			b2FloatW Px = b2MulW(lambda, tx), Py = b2MulW(lambda, ty);
+
+			vAx = b2SubW(vAx, b2MulW(mA, Px));
+			vAy = b2SubW(vAy, b2MulW(mA, Py));
+			wA = b2SubW(wA, b2MulW(iA, b2SubW(b2MulW(rAx[j], Py), b2MulW(rAy[j], Px))));
+
+			vBx = b2AddW(vBx, b2MulW(mB, Px));
+			vBy = b2AddW(vBy, b2MulW(mB, Py));
+			wB = b2AddW(wB, b2MulW(iB, b2SubW(b2MulW(rBx[j], Py), b2MulW(rBy[j], Px))));
+		}
+
+		// Solve normal constraints
+		if (pointCount == 1)
+		{
+			b2FloatW dvx = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rBy[0])), vAx), b2MulW(wA, rAy[0]));
+			b2FloatW dvy = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rBx[0])), vAy), b2MulW(wA, rAx[0]));
+
+			// Compute normal impulse
+			b2FloatW vn = b2AddW(b2MulW(dvx, nx), b2MulW(dvy, ny));
+			b2FloatW lambda = b2MulW(b2SubW(zero, b2LoadW(wc->normalMass[0])), b2SubW(vn, b2LoadW(wc->velocityBias[0])));
+
+			// Clamp the accumulated impulse
+			b2FloatW oldImpulse = b2LoadW(wc->normalImpulse[0]);
+			b2FloatW newImpulse = b2MaxW(b2AddW(oldImpulse, lambda), zero);
+			lambda = b2SubW(newImpulse, oldImpulse);
+			b2StoreW(wc->normalImpulse[0], newImpulse);
+
+			// Apply contact impulse
+			b2FloatW Px = b2MulW(lambda, nx), Py = b2MulW(lambda, ny);
+
+			vAx = b2SubW(vAx, b2MulW(mA, Px));
+			vAy = b2SubW(vAy, b2MulW(mA, Py));
+			wA = b2SubW(wA, b2MulW(iA, b2SubW(b2MulW(rAx[0], Py), b2MulW(rAy[0], Px))));
+
+			vBx = b2AddW(vBx, b2MulW(mB, Px));
+			vBy = b2AddW(vBy, b2MulW(mB, Py));
+			wB = b2AddW(wB, b2MulW(iB, b2SubW(b2MulW(rBx[0], Py), b2MulW(rBy[0], Px))));
+		}
+		else
+		{
+			// The block solver, with every case worked out and the first
+			// valid one picked per lane. See SolveVelocityConstraints.
+			b2FloatW a1 = b2LoadW(wc->normalImpulse[0]);
+			b2FloatW a2 = b2LoadW(wc->normalImpulse[1]);
+
+			b2FloatW dv1x = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rBy[0])), vAx), b2MulW(wA, rAy[0]));
+			b2FloatW dv1y = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rBx[0])), vAy), b2MulW(wA, rAx[0]));
+			b2FloatW dv2x = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rBy[1])), vAx), b2MulW(wA, rAy[1]));
+			b2FloatW dv2y = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rBx[1])), vAy), b2MulW(wA, rAx[1]));
+
+			b2FloatW vn1 = b2AddW(b2MulW(dv1x, nx), b2MulW(dv1y, ny));
+			b2FloatW vn2 = b2AddW(b2MulW(dv2x, nx), b2MulW(dv2y, ny));
+
+			// b' = b - K * a
+			b2FloatW K11 = b2LoadW(wc->K11), K12 = b2LoadW(wc->K12);
+			b2FloatW K21 = b2LoadW(wc->K21), K22 = b2LoadW(wc->K22);
+			b2FloatW bx = b2SubW(b2SubW(vn1, b2LoadW(wc->velocityBias[0])), b2AddW(b2MulW(K11, a1), b2MulW(K21, a2)));
+			b2FloatW by = b2SubW(b2SubW(vn2, b2LoadW(wc->velocityBias[1])), b2AddW(b2MulW(K12, a1), b2MulW(K22, a2)));
+
+			// Case 1: vn = 0
+			b2FloatW N11 = b2LoadW(wc->N11), N12 = b2LoadW(wc->N12);
+			b2FloatW N21 = b2LoadW(wc->N21), N22 = b2LoadW(wc->N22);
+			b2FloatW x1 = b2SubW(zero, b2AddW(b2MulW(N11, bx), b2MulW(N21, by)));
+			b2FloatW x2 = b2SubW(zero, b2AddW(b2MulW(N12, bx), b2MulW(N22, by)));
+			b2FloatW valid = b2AndW(b2GreaterEqualW(x1, zero), b2GreaterEqualW(x2, zero));
+			b2FloatW done = valid;
+
+			// Case 2: vn1 = 0 and x2 = 0
+			b2FloatW c2x1 = b2SubW(zero, b2MulW(b2LoadW(wc->normalMass[0]), bx));
+			b2FloatW c2vn2 = b2AddW(b2MulW(K12, c2x1), by);
+			valid = b2AndW(b2GreaterEqualW(c2x1, zero), b2GreaterEqualW(c2vn2, zero));
+			x1 = b2SelectW(done, x1, b2SelectW(valid, c2x1, x1));
+			x2 = b2SelectW(done, x2, b2SelectW(valid, zero, x2));
+			done = b2SelectW(done, done, valid);
+
+			// Case 3: vn2 = 0 and x1 = 0
+			b2FloatW c3x2 = b2SubW(zero, b2MulW(b2LoadW(wc->normalMass[1]), by));
+			b2FloatW c3vn1 = b2AddW(b2MulW(K21, c3x2), bx);
+			valid = b2AndW(b2GreaterEqualW(c3x2, zero), b2GreaterEqualW(c3vn1, zero));
+			x1 = b2SelectW(done, x1, b2SelectW(valid, zero, x1));
+			x2 = b2SelectW(done, x2, b2SelectW(valid, c3x2, x2));
+			done = b2SelectW(done, done, valid);
+
+			// Case 4: x1 = 0 and x2 = 0
+			valid = b2AndW(b2GreaterEqualW(bx, zero), b2GreaterEqualW(by, zero));
+			x1 = b2SelectW(done, x1, b2SelectW(valid, zero, x1));
+			x2 = b2SelectW(done, x2, b2SelectW(valid, zero, x2));
+			done = b2SelectW(done, done, valid);
+
+			// No solution: keep the old impulses.
+			x1 = b2SelectW(done, x1, a1);
+			x2 = b2SelectW(done, x2, a2);
+
+			// Apply the incremental impulse
+			b2FloatW d1 = b2SubW(x1, a1), d2 = b2SubW(x2, a2);
+			b2FloatW P1x = b2MulW(d1, nx), P1y = b2MulW(d1, ny);
+			b2FloatW P2x = b2MulW(d2, nx), P2y = b2MulW(d2, ny);
+
+			vAx = b2SubW(vAx, b2MulW(mA, b2AddW(P1x, P2x)));
+			vAy = b2SubW(vAy, b2MulW(mA, b2AddW(P1y, P2y)));
+			wA = b2SubW(wA, b2MulW(iA, b2AddW(b2SubW(b2MulW(rAx[0], P1y), b2MulW(rAy[0], P1x)),
+			                                  b2SubW(b2MulW(rAx[1], P2y), b2MulW(rAy[1], P2x)))));
+
+			vBx = b2AddW(vBx, b2MulW(mB, b2AddW(P1x, P2x)));
+			vBy = b2AddW(vBy, b2MulW(mB, b2AddW(P1y, P2y)));
+			wB = b2AddW(wB, b2MulW(iB, b2AddW(b2SubW(b2MulW(rBx[0], P1y), b2MulW(rBy[0], P1x)),
+			                                  b2SubW(b2MulW(rBx[1], P2y), b2MulW(rBy[1], P2x)))));
+
+			b2StoreW(wc->normalImpulse[0], x1);
+			b2StoreW(wc->normalImpulse[1], x2);
+		}
+
+		b2StoreW(gather[0], vAx);
+		b2StoreW(gather[1], vAy);
+		b2StoreW(gather[2], wA);
+		b2StoreW(gather[3], vBx);
+		b2StoreW(gather[4], vBy);
+		b2StoreW(gather[5], wB);
+		for (int32 lane = 0; lane < 4; ++lane)
+		{
+			if (wc->indexA[lane] >= 0)
+			{
+				m_velocities[wc->indexA[lane]].v.Set(gather[0][lane], gather[1][lane]);
+				m_velocities[wc->indexA[lane]].w = gather[2][lane];
+			}
+			if (wc->indexB[lane] >= 0)
+			{
+				m_velocities[wc->indexB[lane]].v.Set(gather[3][lane], gather[4][lane]);
+				m_velocities[wc->indexB[lane]].w = gather[5][lane];
+			}
+		}
+	}
+}
+
 struct b2PositionSolverManifold
 {
 	void Initialize(b2ContactPositionConstraint* pc, const b2Transform& xfA, const b2Transform& xfB, int32 index)
@@ -27,6 +27,7 @@ class b2Contact;
 class b2Body;
 class b2StackAllocator;
 struct b2ContactPositionConstraint;
+struct b2ContactConstraintW;
 
 struct b2VelocityConstraintPoint
 {
@@ -89,6 +90,18 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+
+	// The wide solver's batches, the 2 point ones first, and the
+	// constraints that didn't fit in a batch. NULL when not in use.
+	b2ContactConstraintW* m_wideConstraints;
+	int32 m_wideCount;
+	int32 m_wideTwoPointCount;
+	int32* m_leftovers;
+	int32 m_leftoverCount;
+
+private:
+	void PrepareWide();
+	void SolveWideVelocityConstraints();
 };
 
 #endif
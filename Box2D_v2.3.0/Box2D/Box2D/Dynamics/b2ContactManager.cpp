@@ -21,6 +21,7 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Common/b2StackAllocator.h>
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
@@ -32,6 +33,8 @@ b2ContactManager::b2ContactManager()
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = NULL;
+	m_stackAllocator = NULL;
+	m_taskRunner = NULL;
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -102,71 +105,150 @@ void b2ContactManager::Destroy(b2Contact* c)
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
 // contact list.
-void b2ContactManager::Collide()
+// Filters the contact if flagged, then checks it is awake and its proxies
+// still overlap. Only the filter flag is changed.
+int32 b2ContactManager::Classify(b2Contact* c)
 {
-	// Update awake contacts.
-	b2Contact* c = m_contactList;
-	while (c)
+	b2Fixture* fixtureA = c->GetFixtureA();
+	b2Fixture* fixtureB = c->GetFixtureB();
+	int32 indexA = c->GetChildIndexA();
+	int32 indexB = c->GetChildIndexB();
+	b2Body* bodyA = fixtureA->GetBody();
+	b2Body* bodyB = fixtureB->GetBody();
+	 
+	// Is this contact flagged for filtering?
+	if (c->m_flags & b2Contact::e_filterFlag)
 	{
-		b2Fixture* fixtureA = c->GetFixtureA();
-		b2Fixture* fixtureB = c->GetFixtureB();
-		int32 indexA = c->GetChildIndexA();
-		int32 indexB = c->GetChildIndexB();
-		b2Body* bodyA = fixtureA->GetBody();
-		b2Body* bodyB = fixtureB->GetBody();
-		 
-		// Is this contact flagged for filtering?
-		if (c->m_flags & b2Contact::e_filterFlag)
+		// Should these bodies collide?
+		if (bodyB->ShouldCollide(bodyA) == false)
 		{
-			// Should these bodies collide?
-			if (bodyB->ShouldCollide(bodyA) == false)
-			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
-				continue;
-			}
+			return e_destroy;
+		}
+
+		// Check user filtering.
+		if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
+		{
+			return e_destroy;
+		}
+
+		// Clear the filtering flag.
+		c->m_flags &= ~b2Contact::e_filterFlag;
+	}
+
+	bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+	bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+
+	// At least one body must be awake and it must be dynamic or kinematic.
+	if (activeA == false && activeB == false)
+	{
+		return e_asleep;
+	}
+
+	int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
+	int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
+	bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
 
-			// Check user filtering.
-			if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
+	// Here we destroy contacts that cease to overlap in the broad-phase.
+	if (overlap == false)
+	{
+		return e_destroy;
+	}
+
+	return e_update;
+}
+
+// A contact whose manifold is evaluated on the task runner.
+struct b2ContactUpdate
+{
+	b2Contact* contact;
+	b2Manifold oldManifold;
+	bool touching;
+};
+
+void b2ContactManager::UpdateManifolds(int32 begin, int32 end, void* context)
+{
+	b2ContactUpdate* updates = (b2ContactUpdate*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		updates[i].touching = updates[i].contact->UpdateManifold(&updates[i].oldManifold);
+	}
+}
+
+void b2ContactManager::Collide()
+{
+	if (m_taskRunner == NULL)
+	{
+		// Update awake contacts.
+		b2Contact* c = m_contactList;
+		while (c)
+		{
+			b2Contact* next = c->GetNext();
+			switch (Classify(c))
 			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
-				continue;
+			case e_destroy:
+				Destroy(c);
+				break;
+			case e_update:
+				// The contact persists.
+				c->Update(m_contactListener);
+				break;
+			default:
+				break;
 			}
-
-			// Clear the filtering flag.
-			c->m_flags &= ~b2Contact::e_filterFlag;
+			c = next;
 		}
+		return;
+	}
 
-		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
-		bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
-
-		// At least one body must be awake and it must be dynamic or kinematic.
-		if (activeA == false && activeB == false)
+	// Filter and check every contact first, evaluate the manifolds of the
+	// awake ones on the task runner, then wake bodies and call the listener
+	// in list order. The b2Distance counters aren't thread safe, so sensors
+	// are left to the last pass.
+	b2ContactUpdate* updates = (b2ContactUpdate*)m_stackAllocator->Allocate(m_contactCount * sizeof(b2ContactUpdate));
+	int32 updateCount = 0;
+	for (b2Contact* c = m_contactList, *next; c; c = next)
+	{
+		next = c->GetNext();
+		int32 state = Classify(c);
+		if (state == e_destroy)
 		{
-			c = c->GetNext();
-			continue;
+			Destroy(c);
+		}
+		else if (state == e_update && c->m_fixtureA->IsSensor() == false && c->m_fixtureB->IsSensor() == false)
+		{
+			updates[updateCount++].contact = c;
 		}
+	}
 
-		int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
-		int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
-		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+	m_taskRunner->ParallelFor(updateCount, &b2ContactManager::UpdateManifolds, updates);
 
-		// Here we destroy contacts that cease to overlap in the broad-phase.
-		if (overlap == false)
+	int32 k = 0;
+	for (b2Contact* c = m_contactList, *next; c; c = next)
+	{
+		next = c->GetNext();
+		if (k < updateCount && updates[k].contact == c)
 		{
-			b2Contact* cNuke = c;
-			c = cNuke->GetNext();
-			Destroy(cNuke);
+			c->FinishUpdate(updates[k].oldManifold, updates[k].touching, m_contactListener);
+			++k;
 			continue;
 		}
 
-		// The contact persists.
-		c->Update(m_contactListener);
-		c = c->GetNext();
+		// A sleeping contact may have been woken by one before it, just as
+		// when they are updated one at a time.
+		switch (Classify(c))
+		{
+		case e_destroy:
+			Destroy(c);
+			break;
+		case e_update:
+			c->Update(m_contactListener);
+			break;
+		default:
+			break;
+		}
 	}
+
+	m_stackAllocator->Free(updates);
 }
 
 void b2ContactManager::FindNewContacts()
@@ -25,6 +25,8 @@ class b2Contact;
 class b2ContactFilter;
 class b2ContactListener;
 class b2BlockAllocator;
+class b2StackAllocator;
+class b2TaskRunner;
 
 // Delegate of b2World.
 class b2ContactManager
@@ -40,6 +42,16 @@ public:
 	void Destroy(b2Contact* c);
 
 	void Collide();
+
+	// What Collide should do with a contact.
+	enum
+	{
+		e_update,
+		e_asleep,
+		e_destroy
+	};
+	int32 Classify(b2Contact* c);
+	static void UpdateManifolds(int32 begin, int32 end, void* context);
             
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
@@ -47,6 +59,8 @@ public:
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+	b2StackAllocator* m_stackAllocator;
+	b2TaskRunner* m_taskRunner;
 };
 
 #endif
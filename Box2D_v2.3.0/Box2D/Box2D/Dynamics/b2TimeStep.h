@@ -43,6 +43,7 @@ struct b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool wideContacts;	// solve velocity constraints four at a time
 };
 
 /// This is an internal structure.
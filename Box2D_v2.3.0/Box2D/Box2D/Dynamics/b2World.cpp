@@ -38,6 +38,7 @@ b2World::b2World(const b2Vec2& gravity)
 {
 	m_destructionListener = NULL;
 	m_debugDraw = NULL;
+	m_taskRunner = NULL;
 
 	m_bodyList = NULL;
 	m_jointList = NULL;
@@ -46,6 +47,7 @@ b2World::b2World(const b2Vec2& gravity)
 	m_jointCount = 0;
 
 	m_warmStarting = true;
+	m_wideContacts = false;
 	m_continuousPhysics = true;
 	m_subStepping = false;
 
@@ -59,6 +61,7 @@ b2World::b2World(const b2Vec2& gravity)
 	m_inv_dt0 = 0.0f;
 
 	m_contactManager.m_allocator = &m_blockAllocator;
+	m_contactManager.m_stackAllocator = &m_stackAllocator;
 
 	memset(&m_profile, 0, sizeof(b2Profile));
 }
@@ -94,6 +97,12 @@ void b2World::SetContactFilter(b2ContactFilter* filter)
 	m_contactManager.m_contactFilter = filter;
 }
 
+void b2World::SetTaskRunner(b2TaskRunner* runner)
+{
+	m_taskRunner = runner;
+	m_contactManager.m_taskRunner = runner;
+}
+
 void b2World::SetContactListener(b2ContactListener* listener)
 {
 	m_contactManager.m_contactListener = listener;
@@ -383,19 +392,79 @@ void b2World::SetAllowSleeping(bool flag)
 }
 
 // Find islands, integrate and solve constraints, solve position constraints
+// A built island: its bodies, contacts and joints are ranges of the
+// arrays Solve fills. Static bodies can be in several islands.
+struct b2IslandRange
+{
+	int32 bodyStart, bodyCount;
+	int32 contactStart, contactCount;
+	int32 jointStart, jointCount;
+	bool hasStatic;
+};
+
+struct b2SolveContext
+{
+	const b2TimeStep* step;
+	b2Vec2 gravity;
+	bool allowSleep;
+	b2ContactListener* listener;
+	b2IslandRange* islands;
+	b2Body** bodies;
+	b2Contact** contacts;
+	b2Joint** joints;
+	b2Profile* profiles;
+	bool skipStatic;
+};
+
+// Solves islands [begin, end) with an island and stack of its own. Static
+// bodies take an island index in every island they are in, so islands with
+// one can skip them here and be solved on the calling thread instead.
+void b2World::SolveIslands(int32 begin, int32 end, void* context)
+{
+	b2SolveContext* ctx = (b2SolveContext*)context;
+
+	int32 bodyCapacity = 0, contactCapacity = 0, jointCapacity = 0;
+	for (int32 i = begin; i < end; ++i)
+	{
+		bodyCapacity = b2Max(bodyCapacity, ctx->islands[i].bodyCount);
+		contactCapacity = b2Max(contactCapacity, ctx->islands[i].contactCount);
+		jointCapacity = b2Max(jointCapacity, ctx->islands[i].jointCount);
+	}
+
+	b2StackAllocator allocator;
+	b2Island island(bodyCapacity, contactCapacity, jointCapacity, &allocator, ctx->listener);
+	for (int32 i = begin; i < end; ++i)
+	{
+		const b2IslandRange& range = ctx->islands[i];
+		if (ctx->skipStatic && range.hasStatic)
+		{
+			continue;
+		}
+
+		island.Clear();
+		for (int32 k = 0; k < range.bodyCount; ++k)
+		{
+			island.Add(ctx->bodies[range.bodyStart + k]);
+		}
+		for (int32 k = 0; k < range.contactCount; ++k)
+		{
+			island.Add(ctx->contacts[range.contactStart + k]);
+		}
+		for (int32 k = 0; k < range.jointCount; ++k)
+		{
+			island.Add(ctx->joints[range.jointStart + k]);
+		}
+
+		island.Solve(ctx->profiles + i, *ctx->step, ctx->gravity, ctx->allowSleep);
+	}
+}
+
 void b2World::Solve(const b2TimeStep& step)
 {
 	m_profile.solveInit = 0.0f;
 	m_profile.solveVelocity = 0.0f;
 	m_profile.solvePosition = 0.0f;
 
-	// Size the island for the worst case.
-	b2Island island(m_bodyCount,
-					m_contactManager.m_contactCount,
-					m_jointCount,
-					&m_stackAllocator,
-					m_contactManager.m_contactListener);
-
 	// Clear all the island flags.
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
@@ -410,7 +479,18 @@ void b2World::Solve(const b2TimeStep& step)
 		j->m_islandFlag = false;
 	}
 
-	// Build and simulate all awake islands.
+	// Every island is built before any is solved. They share no dynamic or
+	// kinematic bodies, so solving them in any order, or at once, gives the
+	// same result. A static body is repeated in each island that touches it,
+	// at most once per contact or joint.
+	int32 bodyCapacity = m_bodyCount + m_contactManager.m_contactCount + m_jointCount;
+	b2IslandRange* islands = (b2IslandRange*)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2IslandRange));
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(bodyCapacity * sizeof(b2Body*));
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(m_contactManager.m_contactCount * sizeof(b2Contact*));
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+	int32 islandCount = 0, bodyCount = 0, contactCount = 0, jointCount = 0;
+
+	// Build all awake islands.
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
 	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
@@ -431,8 +511,12 @@ void b2World::Solve(const b2TimeStep& step)
 			continue;
 		}
 
-		// Reset island and stack.
-		island.Clear();
+		// Start a new island and reset the stack.
+		b2IslandRange* range = islands + islandCount++;
+		range->bodyStart = bodyCount;
+		range->contactStart = contactCount;
+		range->jointStart = jointCount;
+		range->hasStatic = false;
 		int32 stackCount = 0;
 		stack[stackCount++] = seed;
 		seed->m_flags |= b2Body::e_islandFlag;
@@ -443,7 +527,8 @@ void b2World::Solve(const b2TimeStep& step)
 			// Grab the next body off the stack and add it to the island.
 			b2Body* b = stack[--stackCount];
 			b2Assert(b->IsActive() == true);
-			island.Add(b);
+			b2Assert(bodyCount < bodyCapacity);
+			bodies[bodyCount++] = b;
 
 			// Make sure the body is awake.
 			b->SetAwake(true);
@@ -452,6 +537,7 @@ void b2World::Solve(const b2TimeStep& step)
 			// propagate islands across static bodies.
 			if (b->GetType() == b2_staticBody)
 			{
+				range->hasStatic = true;
 				continue;
 			}
 
@@ -481,7 +567,7 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
-				island.Add(contact);
+				contacts[contactCount++] = contact;
 				contact->m_flags |= b2Contact::e_islandFlag;
 
 				b2Body* other = ce->other;
@@ -513,7 +599,7 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
-				island.Add(je->joint);
+				joints[jointCount++] = je->joint;
 				je->joint->m_islandFlag = true;
 
 				if (other->m_flags & b2Body::e_islandFlag)
@@ -527,26 +613,70 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 		}
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+		range->bodyCount = bodyCount - range->bodyStart;
+		range->contactCount = contactCount - range->contactStart;
+		range->jointCount = jointCount - range->jointStart;
 
-		// Post solve cleanup.
-		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		// Allow static bodies to participate in other islands.
+		for (int32 i = range->bodyStart; i < bodyCount; ++i)
 		{
-			// Allow static bodies to participate in other islands.
-			b2Body* b = island.m_bodies[i];
-			if (b->GetType() == b2_staticBody)
+			if (bodies[i]->GetType() == b2_staticBody)
 			{
-				b->m_flags &= ~b2Body::e_islandFlag;
+				bodies[i]->m_flags &= ~b2Body::e_islandFlag;
 			}
 		}
 	}
 
 	m_stackAllocator.Free(stack);
 
+	// Solve the islands. Each one's profile is kept apart and summed in
+	// island order, so the totals don't depend on the threads either.
+	b2Profile* profiles = (b2Profile*)m_stackAllocator.Allocate(islandCount * sizeof(b2Profile));
+	b2SolveContext context;
+	context.step = &step;
+	context.gravity = m_gravity;
+	context.allowSleep = m_allowSleep;
+	context.listener = m_contactManager.m_contactListener;
+	context.islands = islands;
+	context.bodies = bodies;
+	context.contacts = contacts;
+	context.joints = joints;
+	context.profiles = profiles;
+
+	if (m_taskRunner && islandCount > 1)
+	{
+		context.skipStatic = true;
+		m_taskRunner->ParallelFor(islandCount, &b2World::SolveIslands, &context);
+
+		// Now the islands with static bodies, one at a time.
+		context.skipStatic = false;
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			if (islands[i].hasStatic)
+			{
+				SolveIslands(i, i + 1, &context);
+			}
+		}
+	}
+	else
+	{
+		context.skipStatic = false;
+		SolveIslands(0, islandCount, &context);
+	}
+
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		m_profile.solveInit += profiles[i].solveInit;
+		m_profile.solveVelocity += profiles[i].solveVelocity;
+		m_profile.solvePosition += profiles[i].solvePosition;
+	}
+
+	m_stackAllocator.Free(profiles);
+	m_stackAllocator.Free(joints);
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(bodies);
+	m_stackAllocator.Free(islands);
+
 	{
 		b2Timer timer;
 		// Synchronize fixtures, check for out of range bodies.
@@ -860,6 +990,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		subStep.wideContacts = false;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -923,6 +1054,7 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.wideContacts = m_wideContacts;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
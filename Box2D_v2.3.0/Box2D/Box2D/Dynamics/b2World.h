@@ -57,6 +57,13 @@ public:
 	/// owned by you and must remain in scope. 
 	void SetContactFilter(b2ContactFilter* filter);
 
+	/// Register a task runner to evaluate contact manifolds and solve independent
+	/// islands on several threads. The results are the same as doing it all on
+	/// the calling thread. The runner
+	/// is owned by you and must remain in scope. Pass NULL to go back to one thread.
+	/// @warning b2ContactListener::PostSolve may be called from the runner's threads.
+	void SetTaskRunner(b2TaskRunner* runner);
+
 	/// Register a contact event listener. The listener is owned by you and must
 	/// remain in scope.
 	void SetContactListener(b2ContactListener* listener);
@@ -149,6 +156,13 @@ public:
 	void SetWarmStarting(bool flag) { m_warmStarting = flag; }
 	bool GetWarmStarting() const { return m_warmStarting; }
 
+	/// Enable/disable the wide contact solver. Contacts that share no moving body
+	/// are grouped in fours and their velocity constraints solved together with
+	/// SIMD. The order they are solved in changes, so results differ slightly
+	/// from the default solver.
+	void SetWideContactSolver(bool flag) { m_wideContacts = flag; }
+	bool GetWideContactSolver() const { return m_wideContacts; }
+
 	/// Enable/disable continuous physics. For testing.
 	void SetContinuousPhysics(bool flag) { m_continuousPhysics = flag; }
 	bool GetContinuousPhysics() const { return m_continuousPhysics; }
@@ -225,6 +239,7 @@ private:
 	friend class b2Controller;
 
 	void Solve(const b2TimeStep& step);
+	static void SolveIslands(int32 begin, int32 end, void* context);
 	void SolveTOI(const b2TimeStep& step);
 
 	void DrawJoint(b2Joint* joint);
@@ -248,6 +263,7 @@ private:
 
 	b2DestructionListener* m_destructionListener;
 	b2Draw* m_debugDraw;
+	b2TaskRunner* m_taskRunner;
 
 	// This is used to compute the time step ratio to
 	// support a variable time step.
@@ -255,6 +271,7 @@ private:
 
 	// These are for debugging the solver.
 	bool m_warmStarting;
+	bool m_wideContacts;
 	bool m_continuousPhysics;
 	bool m_subStepping;
 
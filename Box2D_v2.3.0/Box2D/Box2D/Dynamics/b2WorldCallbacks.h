@@ -152,4 +152,17 @@ public:
 									const b2Vec2& normal, float32 fraction) = 0;
 };
 
+/// Implement this class to let the world spread independent work over
+/// your own threads. See b2World::SetTaskRunner
+class b2TaskRunner
+{
+public:
+	virtual ~b2TaskRunner() {}
+
+	/// Call task(begin, end, context) on slices that cover [0, count) between
+	/// them, possibly at the same time on different threads, and return once
+	/// every slice is done.
+	virtual void ParallelFor(int32 count, void (*task)(int32 begin, int32 end, void* context), void* context) = 0;
+};
+
 #endif
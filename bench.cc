@@ -0,0 +1,337 @@
+// Times the simulator's hot spots at fixed seeds, so that a table from one
+// commit can be compared with another's
+// Usage: bench [-s steps] [-o table] [-w]
+// Run from the top of the tree, as it reads shapes/square.txt. Each row is
+// one benchmark at one scale: its name, the robots and boxes, how many
+// calls were timed, their total time and the time per call
+// With -w it instead checks the wide contact solver against the scalar
+// one, and exits with 1 if they disagree by more than the tolerances below.
+// Its runs are 6000 steps unless -s says otherwise, as it takes thousands
+// before the robots reach the boxes
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "push.hh"
+
+struct Scale
+{
+  size_t robots, boxes;
+};
+
+static const Scale scales[] = {{64, 256}, {250, 1000}, {1000, 4000}};
+
+static const char *POLYGON = "shapes/square.txt";
+
+// Keeps the compiler from dropping work whose result nothing uses
+static volatile double sink;
+
+static FILE *table = stdout;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Since(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void Report(const char *name, const Scale &scale, size_t calls, double ms)
+{
+  fprintf(table, "%s\t%lu\t%lu\t%lu\t%.3f\t%.3f\n", name, (unsigned long)scale.robots,
+          (unsigned long)scale.boxes, (unsigned long)calls, ms, ms * 1000.0 / calls);
+  fflush(table);
+}
+
+// A run's worth of world, made the same way every time for @scale
+class Setup
+{
+public:
+  World world;
+  Simulation simulation;
+
+  Setup(const Scale &scale, bool polygon, uint64_t maxSteps, bool wideContacts = false)
+      : world(64, 64, 64 * 64, 1, 1.5, 0.25, true, false),
+        simulation(&world, Config(scale, polygon, maxSteps, wideContacts))
+  {
+    if (!simulation.Populate())
+    {
+      fprintf(stderr, "Could not read %s\n", POLYGON);
+      exit(1);
+    }
+  }
+
+private:
+  static RunConfig Config(const Scale &scale, bool polygon, uint64_t maxSteps, bool wideContacts)
+  {
+    RunConfig config;
+    config.robots = scale.robots;
+    config.boxes = scale.boxes;
+    config.robotType = Robot::SHAPE_CIRC;
+    config.boxType = Box::SHAPE_HEX;
+    config.flare = 1.5;
+    config.drag = 0.25;
+    config.switchToCircle = true;
+    config.seed = 1;
+    config.haveSeed = true;
+    config.maxSteps = maxSteps;
+    config.verbose = false;
+    config.polygonFile = polygon ? POLYGON : "";
+    config.wideContacts = wideContacts;
+    return config;
+  }
+};
+
+static void BenchLights(const Scale &scale)
+{
+  Setup setup(scale, false, 0);
+  World &world = setup.world;
+  world.UpdateLightPattern(32, 32, 1, 16, 0.1, 0.25);
+
+  const size_t passes = 100;
+  Clock::time_point start = Clock::now();
+  double total = 0;
+  for (size_t pass = 0; pass < passes; ++pass)
+    for (auto &r : world.robots)
+    {
+      const b2Vec2 here = r->body->GetWorldCenter();
+      total += world.GetLightIntensityAt(here.x, here.y);
+    }
+  Report("GetLightIntensityAt", scale, passes * world.robots.size(), Since(start));
+  sink = total;
+}
+
+// The pattern contracting from near the walls to the middle, as a run does
+static void BenchPattern(const Scale &scale, bool polygon)
+{
+  Setup setup(scale, polygon, 0);
+  World &world = setup.world;
+
+  const size_t calls = 200;
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < calls; ++i)
+  {
+    if (polygon)
+      world.polygon->scale(0.99);
+    world.UpdateLightPattern(32, 32, 1, 24.0 - 20.0 * i / calls, 0.1, 0.25);
+  }
+  Report(polygon ? "UpdateLightPatternPolygon" : "UpdateLightPatternCircle", scale, calls, Since(start));
+}
+
+static void BenchPolygon(const Scale &scale)
+{
+  Setup setup(scale, true, 0);
+  World &world = setup.world;
+
+  const size_t passes = 20;
+  double total = 0;
+  Clock::time_point start = Clock::now();
+  for (size_t pass = 0; pass < passes; ++pass)
+    for (auto &b : world.boxes)
+    {
+      const b2Vec2 pos = b->body->GetPosition();
+      total += world.goalPolygon->getDistFromPoint(pos.x, pos.y);
+    }
+  Report("getDistFromPoint", scale, passes * world.boxes.size(), Since(start));
+
+  start = Clock::now();
+  for (size_t pass = 0; pass < passes; ++pass)
+    for (auto &b : world.boxes)
+    {
+      const b2Vec2 pos = b->body->GetPosition();
+      total += world.goalPolygon->pointInsidePoly(pos.x, pos.y);
+    }
+  Report("pointInsidePoly", scale, passes * world.boxes.size(), Since(start));
+  sink = total;
+}
+
+// Writes @frames frames in @format to a scratch file, then reads them back
+static void BenchReplay(const Scale &scale, char format)
+{
+  const std::string fileName = (format == 'T') ? "bench_replay.txt" : "bench_replay.bin";
+  const size_t frames = 100;
+  {
+    Setup setup(scale, false, 0);
+    World &world = setup.world;
+    world.replayFormat = format;
+
+    Clock::time_point start = Clock::now();
+    world.saveWorldHeader(fileName);
+    for (size_t i = 0; i < frames; ++i)
+      world.appendWorldStateToFile(fileName);
+    world.CloseOutputs();
+    Report(format == 'T' ? "ReplayWriteText" : "ReplayWriteBinary", scale, frames, Since(start));
+  }
+
+  double total = 0;
+  Clock::time_point start = Clock::now();
+  if (format == 'T')
+  {
+    TextReplayReader replay(fileName);
+    while (replay.NextState())
+      for (auto &b : replay.boxes)
+        total += b.x;
+  }
+  else
+  {
+    ReplayReader replay(fileName);
+    for (size_t frame = 0; frame < replay.Frames(); ++frame)
+    {
+      const ReplayBox *boxes = replay.Boxes(frame);
+      for (size_t i = 0; i < replay.BoxCount(); ++i)
+        total += boxes[i].x;
+    }
+  }
+  Report(format == 'T' ? "ReplayReadText" : "ReplayReadBinary", scale, frames, Since(start));
+  sink = total;
+  unlink(fileName.c_str());
+}
+
+// Only the first packing of a shape is worked out; the rest come from a
+// cache. Every scale and shape is new here, so this times the real thing
+static void BenchGoals(const Scale &scale, bool polygon)
+{
+  Setup setup(scale, polygon, 0);
+  Clock::time_point start = Clock::now();
+  setup.world.populateGoals(setup.simulation.GoalRadCircle());
+  Report(polygon ? "populateGoalsPolygon" : "populateGoalsCircle", scale, 1, Since(start));
+}
+
+// Whole steps, with the pattern updates and success evaluation of a run
+static void BenchStep(const Scale &scale, uint64_t steps)
+{
+  Setup setup(scale, true, steps);
+  Clock::time_point start = Clock::now();
+  setup.simulation.Run();
+  Report("Step", scale, steps, Since(start));
+}
+
+// The wide solver visits contacts in another order, so it converges to a
+// slightly different answer; these bound how different
+static const double MAX_VELOCITY_DIFFERENCE = 0.05; // Of the fastest body's speed
+static const double MAX_SUCCESS_DIFFERENCE = 0.1;   // Of the boxes
+
+static const uint64_t COMPARE_STEPS = 6000;
+
+// Runs that long at the largest scale take many minutes, so it's left out
+static const size_t COMPARE_SCALES = 2;
+
+static std::vector<b2Body *> Bodies(World &world)
+{
+  std::vector<b2Body *> bodies;
+  for (auto &r : world.robots)
+    bodies.push_back(r->body);
+  for (auto &b : world.boxes)
+    bodies.push_back(b->body);
+  return bodies;
+}
+
+// Two worlds take the same @steps scalar steps, then one more step each,
+// with the scalar and the wide solver, and their velocities are compared.
+// Whole runs of @steps with each solver then give the time spent solving
+// velocities and the fraction of boxes that end in the goal
+static bool CompareContactSolvers(const Scale &scale, uint64_t steps)
+{
+  Setup scalar(scale, true, steps), wide(scale, true, steps);
+  scalar.simulation.Run();
+  wide.simulation.Run();
+  std::vector<b2Body *> a = Bodies(scalar.world), b = Bodies(wide.world);
+  for (size_t i = 0; i < a.size(); ++i)
+    if (!(a[i]->GetPosition() == b[i]->GetPosition()) || a[i]->GetAngle() != b[i]->GetAngle())
+    {
+      fprintf(stderr, "The runs differ before their solvers do\n");
+      return false;
+    }
+
+  const double timeStep = RunConfig().timeStep;
+  scalar.world.Step(timeStep);
+  wide.world.b2world->SetWideContactSolver(true);
+  wide.world.Step(timeStep);
+  double maxSpeed = 0, maxDifference = 0, totalDifference = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    const double difference = (a[i]->GetLinearVelocity() - b[i]->GetLinearVelocity()).Length();
+    maxSpeed = std::max(maxSpeed, (double)a[i]->GetLinearVelocity().Length());
+    maxDifference = std::max(maxDifference, difference);
+    totalDifference += difference;
+  }
+
+  double solveVelocity[2], success[2];
+  for (int w = 0; w < 2; ++w)
+  {
+    Setup run(scale, true, steps, w == 1);
+    run.world.EnableProfiler();
+    success[w] = run.simulation.Run();
+    solveVelocity[w] = run.world.profiler->Total(StepProfiler::SOLVE_VELOCITY);
+  }
+
+  fprintf(table, "%lu\t%lu\t%lu\t%g\t%g\t%g\t%.3f\t%.3f\t%g\t%g\n", (unsigned long)scale.robots,
+          (unsigned long)scale.boxes, (unsigned long)steps, maxSpeed, maxDifference,
+          totalDifference / a.size(), solveVelocity[0], solveVelocity[1], success[0], success[1]);
+  fflush(table);
+  return maxDifference <= MAX_VELOCITY_DIFFERENCE * maxSpeed &&
+         fabs(success[0] - success[1]) <= MAX_SUCCESS_DIFFERENCE;
+}
+
+int main(int argc, char *argv[])
+{
+  uint64_t steps = 0; // Each mode has its own default
+  bool compareSolvers = false;
+  int ch;
+  while ((ch = getopt(argc, argv, "s:o:w")) != -1)
+  {
+    if (ch == 's')
+      steps = strtoull(optarg, NULL, 10);
+    else if (ch == 'o')
+    {
+      table = fopen(optarg, "w");
+      if (!table)
+      {
+        fprintf(stderr, "Could not write %s\n", optarg);
+        return 1;
+      }
+    }
+    else if (ch == 'w')
+      compareSolvers = true;
+    else
+    {
+      fprintf(stderr, "Usage: %s [-s steps] [-o table] [-w]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (compareSolvers)
+  {
+    fprintf(table, "Robots\tBoxes\tSteps\tMaxSpeed\tMaxVelocityDifference\tMeanVelocityDifference\t"
+                   "ScalarSolveVelocityMs\tWideSolveVelocityMs\tScalarSuccess\tWideSuccess\n");
+    bool agree = true;
+    for (size_t i = 0; i < COMPARE_SCALES; ++i)
+      agree = CompareContactSolvers(scales[i], steps ? steps : COMPARE_STEPS) && agree;
+    if (table != stdout)
+      fclose(table);
+    return agree ? 0 : 1;
+  }
+
+  fprintf(table, "Benchmark\tRobots\tBoxes\tCalls\tTotalMs\tUsPerCall\n");
+  for (auto &scale : scales)
+  {
+    BenchLights(scale);
+    BenchPattern(scale, false);
+    BenchPattern(scale, true);
+    BenchPolygon(scale);
+    BenchReplay(scale, 'T');
+    BenchReplay(scale, 'B');
+    BenchGoals(scale, false);
+    BenchGoals(scale, true);
+    BenchStep(scale, steps ? steps : 200);
+  }
+
+  if (table != stdout)
+    fclose(table);
+  return 0;
+}
@@ -5,6 +5,8 @@
 Box::Box(World &world, box_shape_t shape, double size, double x, double y, double a)
     : body(NULL),
       insidePoly(false),
+      settled(false),
+      stillTime(0),
       size(size)
 {
   b2PolygonShape dynamicBox;
@@ -63,6 +65,7 @@ Box::Box(World &world, box_shape_t shape, double size, double x, double y, doubl
   bodyDef.type = b2_dynamicBody;
 
   body = world.b2world->CreateBody(&bodyDef);
+  body->SetUserData(this); // For BoxSettler
   body->SetLinearDamping(10.0);
   body->SetAngularDamping(10.0);
   body->SetTransform(b2Vec2(x, y), a);
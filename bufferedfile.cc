@@ -0,0 +1,131 @@
+#include "push.hh"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+BufferedFile::BufferedFile(const std::string &fileName, bool truncate, bool background, size_t bufferSize) : fd(-1),
+                                                                                                            bufferSize(bufferSize),
+                                                                                                            offset(0),
+                                                                                                            busy(false),
+                                                                                                            stopping(false)
+{
+  fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Could not open %s for writing\n", fileName.c_str());
+    return;
+  }
+  offset = lseek(fd, 0, SEEK_END);
+  buffer.reserve(bufferSize);
+
+  if (background)
+    writer = std::thread(&BufferedFile::WriterLoop, this);
+}
+
+BufferedFile::~BufferedFile()
+{
+  Close();
+}
+
+void BufferedFile::Write(const void *data, size_t bytes)
+{
+  if (fd < 0)
+    return;
+  buffer.append((const char *)data, bytes);
+  offset += bytes;
+  if (buffer.size() >= bufferSize)
+    Flush();
+}
+
+void BufferedFile::Write(const std::string &text)
+{
+  Write(text.data(), text.size());
+}
+
+void BufferedFile::Flush()
+{
+  if (fd < 0 || buffer.empty())
+    return;
+
+  if (!writer.joinable())
+  {
+    WriteOut(buffer);
+    buffer.clear();
+    return;
+  }
+
+  // Hand the buffer over and start a fresh one; the thread does the waiting
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queue.push_back(std::string());
+    queue.back().swap(buffer);
+  }
+  wake.notify_one();
+  buffer.reserve(bufferSize);
+}
+
+void BufferedFile::Sync()
+{
+  Flush();
+  if (writer.joinable())
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    drained.wait(guard, [this] { return queue.empty() && !busy; });
+  }
+}
+
+void BufferedFile::Close()
+{
+  if (fd < 0)
+    return;
+  Sync();
+  if (writer.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+  }
+  close(fd);
+  fd = -1;
+}
+
+void BufferedFile::WriteOut(const std::string &data)
+{
+  size_t done = 0;
+  while (done < data.size())
+  {
+    const ssize_t n = write(fd, data.data() + done, data.size() - done);
+    if (n <= 0)
+    {
+      perror("write");
+      return;
+    }
+    done += n;
+  }
+}
+
+void BufferedFile::WriterLoop()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;)
+  {
+    wake.wait(guard, [this] { return stopping || !queue.empty(); });
+    if (queue.empty())
+      return; // stopping, and nothing left
+
+    std::string data;
+    data.swap(queue.front());
+    queue.pop_front();
+    busy = true;
+    guard.unlock();
+    WriteOut(data);
+    guard.lock();
+    busy = false;
+    if (queue.empty())
+      drained.notify_all();
+  }
+}
@@ -0,0 +1,186 @@
+#include "push.hh"
+#include <math.h>
+#include <algorithm>
+
+GoalGrid::GoalGrid(double width, double height, double cellSize) : width(width),
+                                                                   height(height),
+                                                                   stale(true)
+{
+  SetCellSize(cellSize);
+}
+
+void GoalGrid::SetCellSize(double cellSize)
+{
+  this->cellSize = cellSize;
+  cols = std::max(1, (int)ceil(width / cellSize));
+  rows = std::max(1, (int)ceil(height / cellSize));
+  stale = true;
+}
+
+int GoalGrid::Column(double x) const
+{
+  return std::min(cols - 1, std::max(0, (int)floor(x / cellSize)));
+}
+
+int GoalGrid::Row(double y) const
+{
+  return std::min(rows - 1, std::max(0, (int)floor(y / cellSize)));
+}
+
+void GoalGrid::Add(Goal *goal)
+{
+  goals.push_back(goal);
+  stale = true;
+}
+
+void GoalGrid::Clear()
+{
+  goals.clear();
+  sorted.clear();
+  stale = true;
+}
+
+const std::vector<Goal *> &GoalGrid::Sorted()
+{
+  if (stale)
+    Rebuild();
+  return sorted;
+}
+
+void GoalGrid::Rebuild()
+{
+  // Count, prefix sum, then place. Placing in insertion order keeps
+  // each cell's goals in the order they were added
+  cellStart.assign(cols * rows + 1, 0);
+  for (auto g : goals)
+    ++cellStart[Column(g->x) * rows + Row(g->y) + 1];
+  for (size_t c = 1; c < cellStart.size(); ++c)
+    cellStart[c] += cellStart[c - 1];
+
+  std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+  sorted.resize(goals.size());
+  for (auto g : goals)
+    sorted[next[Column(g->x) * rows + Row(g->y)]++] = g;
+  stale = false;
+
+  // The last pairs refer to the old order
+  boxGoal.clear();
+}
+
+void GoalGrid::Unfulfill()
+{
+  for (auto g : goals)
+    g->fulfilled = false;
+}
+
+size_t GoalGrid::Match(const std::vector<b2Vec2> &positions, double radius)
+{
+  if (stale)
+    Rebuild();
+  const int numBoxes = positions.size();
+
+  // Every goal each box could fulfil, from the cells the radius reaches
+  const double radiusSq = radius * radius;
+  edgeStart.assign(1, 0);
+  edges.clear();
+  for (auto &pos : positions)
+  {
+    const int x0 = Column(pos.x - radius), x1 = Column(pos.x + radius);
+    const int y0 = Row(pos.y - radius), y1 = Row(pos.y + radius);
+    for (int x = x0; x <= x1; ++x)
+      for (int y = y0; y <= y1; ++y)
+      {
+        const int cell = x * rows + y;
+        for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k)
+        {
+          const double dx = sorted[k]->x - pos.x, dy = sorted[k]->y - pos.y;
+          if (dx * dx + dy * dy <= radiusSq)
+            edges.push_back(k);
+        }
+      }
+    edgeStart.push_back(edges.size());
+  }
+
+  // Boxes move little between checks, so most of the last pairs still hold
+  size_t matched = 0;
+  if (boxGoal.size() != (size_t)numBoxes)
+    boxGoal.assign(numBoxes, -1);
+  goalBox.assign(sorted.size(), -1);
+  for (int b = 0; b < numBoxes; ++b)
+  {
+    const int g = boxGoal[b];
+    if (g < 0)
+      continue;
+    const double dx = sorted[g]->x - positions[b].x, dy = sorted[g]->y - positions[b].y;
+    if (dx * dx + dy * dy <= radiusSq)
+    {
+      goalBox[g] = b;
+      ++matched;
+    }
+    else
+      boxGoal[b] = -1;
+  }
+
+  while (Layer())
+  {
+    edgeNext.assign(edgeStart.begin(), edgeStart.end() - 1);
+    for (int b = 0; b < numBoxes; ++b)
+      if (boxGoal[b] < 0 && Augment(b))
+        ++matched;
+  }
+
+  for (size_t k = 0; k < sorted.size(); ++k)
+    sorted[k]->fulfilled = goalBox[k] >= 0;
+  return matched;
+}
+
+// Breadth first from the unpaired boxes, through pairs, to an unpaired
+// goal. False when there is none, so the matching can't grow
+bool GoalGrid::Layer()
+{
+  bool found = false;
+  layer.assign(boxGoal.size(), -1);
+  queue.clear();
+  for (size_t b = 0; b < boxGoal.size(); ++b)
+    if (boxGoal[b] < 0)
+    {
+      layer[b] = 0;
+      queue.push_back(b);
+    }
+
+  for (size_t q = 0; q < queue.size(); ++q)
+  {
+    const int b = queue[q];
+    for (uint32_t e = edgeStart[b]; e < edgeStart[b + 1]; ++e)
+    {
+      const int other = goalBox[edges[e]];
+      if (other < 0)
+        found = true;
+      else if (layer[other] < 0)
+      {
+        layer[other] = layer[b] + 1;
+        queue.push_back(other);
+      }
+    }
+  }
+  return found;
+}
+
+// Follows the layers down to an unpaired goal and flips the pairs on
+// the way back. Dead ends are dropped from the layers
+bool GoalGrid::Augment(int box)
+{
+  for (; edgeNext[box] < edgeStart[box + 1]; ++edgeNext[box])
+  {
+    const int g = edges[edgeNext[box]];
+    const int other = goalBox[g];
+    if (other < 0 || (layer[other] == layer[box] + 1 && Augment(other)))
+    {
+      boxGoal[box] = g;
+      goalBox[g] = box;
+      return true;
+    }
+  }
+  layer[box] = -1;
+  return false;
+}
@@ -10,12 +10,6 @@ const double c_gray[3] = {0.9, 0.9, 1.0};
 const double c_royalblue[3] = {0.20, 0.55, 0.90};
 const double c_barbiepink[3] = {1.0, 0.41, 0.70};
 
-bool World::paused = false;
-bool World::replay_paused = false;
-bool World::replayWorld = false;
-bool GuiWorld::step = false;
-int GuiWorld::skip = 10;
-
 void DrawDisk(double cx, double cy, double r, const double color[3], bool fill);
 
 double RTOD(double rad)
@@ -33,42 +27,76 @@ double RTOD(double rad)
 void key_callback(GLFWwindow *window,
 				  int key, int scancode, int action, int mods)
 {
+	// The window belongs to exactly one world
+	GuiWorld *world = (GuiWorld *)glfwGetWindowUserPointer(window);
+	if (!world)
+		return;
+
 	if (action == GLFW_PRESS)
 		switch (key)
 		{
 		case GLFW_KEY_SPACE:
-			if (!GuiWorld::replayWorld)
+			if (!world->replayWorld)
 			{
-				GuiWorld::paused = !GuiWorld::paused;
+				world->paused = !world->paused;
 			}
 			else
 			{
-				GuiWorld::replay_paused = !GuiWorld::replay_paused;
+				world->replay_paused = !world->replay_paused;
 			}
 			break;
 
 		case GLFW_KEY_S:
-			GuiWorld::paused = true;
-			GuiWorld::step = true; //!GuiWorld::step;
+			world->paused = true;
+			world->step = true; //!world->step;
+			break;
+
+		// Jumping only works in binary replays
+		case GLFW_KEY_LEFT:
+			world->replay_seek -= (mods & GLFW_MOD_SHIFT) ? 100 : 10;
+			break;
+		case GLFW_KEY_RIGHT:
+			world->replay_seek += (mods & GLFW_MOD_SHIFT) ? 100 : 10;
 			break;
 
 		case GLFW_KEY_LEFT_BRACKET:
 			if (mods & GLFW_MOD_SHIFT)
-				GuiWorld::skip = 0;
+				world->skip = 0;
 			else
-				GuiWorld::skip = std::max(0, --GuiWorld::skip);
+				world->skip = std::max(0, world->skip - 1);
 			break;
 		case GLFW_KEY_RIGHT_BRACKET:
 			if (mods & GLFW_MOD_SHIFT)
-				GuiWorld::skip = 500;
+				world->skip = 500;
 			else
-				GuiWorld::skip++;
+				world->skip++;
 			break;
 		default:
 			break;
 		}
 }
 
+// Filled, with a darker outline
+void DrawPolygon(const b2Vec2 *w, int count, const double color[3])
+{
+	glColor3dv(color);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glBegin(GL_POLYGON);
+
+	for (int i = 0; i < count; i++)
+		glVertex2f(w[i].x, w[i].y);
+	glEnd();
+
+	glLineWidth(1.0);
+	glColor3f(color[0] / 5, color[1] / 5, color[2] / 5);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	glBegin(GL_POLYGON);
+
+	for (int i = 0; i < count; i++)
+		glVertex2f(w[i].x, w[i].y);
+	glEnd();
+}
+
 void DrawBody(b2Body *b, const double color[3], double size)
 {
 	for (b2Fixture *f = b->GetFixtureList(); f; f = f->GetNext())
@@ -89,32 +117,10 @@ void DrawBody(b2Body *b, const double color[3], double size)
 			b2PolygonShape *poly = (b2PolygonShape *)f->GetShape();
 
 			const int count = poly->GetVertexCount();
-
-			glColor3dv(color);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glBegin(GL_POLYGON);
-
-			for (int i = 0; i < count; i++)
-			{
-				const b2Vec2 w = b->GetWorldPoint(poly->GetVertex(i));
-				glVertex2f(w.x, w.y);
-			}
-			glEnd();
-
-			glLineWidth(1.0);
-			glColor3f(color[0] / 5, color[1] / 5, color[2] / 5);
-			//glColor3dv( color );
-			//glColor3f( 0,0,0 );
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			glBegin(GL_POLYGON);
-
+			b2Vec2 w[b2_maxPolygonVertices];
 			for (int i = 0; i < count; i++)
-			{
-				const b2Vec2 &v = poly->GetVertex(i);
-				const b2Vec2 w = b->GetWorldPoint(v);
-				glVertex2f(w.x, w.y);
-			}
-			glEnd();
+				w[i] = b->GetWorldPoint(poly->GetVertex(i));
+			DrawPolygon(w, count, color);
 		}
 		break;
 		default:
@@ -123,6 +129,17 @@ void DrawBody(b2Body *b, const double color[3], double size)
 	}
 }
 
+// Goals have no body, so they are drawn from their own geometry
+void DrawGoal(const Goal *g, const double color[3])
+{
+	b2Vec2 w[6];
+	const int count = g->Outline(w);
+	if (count)
+		DrawPolygon(w, count, color);
+	else
+		DrawDisk(g->x, g->y, g->size / 2.0, color, true);
+}
+
 void DrawDisk(double cx, double cy, double r, const double color[3], bool fill)
 {
 	const int num_segments = 32.0 * sqrtf(r);
@@ -175,10 +192,11 @@ void DrawDisk(double cx, double cy, double r, const double color[3], bool fill)
 GuiWorld::GuiWorld(double width, double height, int numLights, int drawinterval, double flare, double drag, bool switchToCircle, bool replayworld) : 
 																	World(width, height, numLights, draw_interval, flare, drag, switchToCircle, replayworld),
 																	window(NULL),
-																	lights_need_redraw(true)
+																	step(false),
+																	lights_need_redraw(true),
+																	brightMax(0)
 {
-	replayWorld = replayworld;
-	srand48(time(NULL));
+	lightWatchers.push_back(&brightChanges);
 	skip = drawinterval;
 
 	/* Initialize the gui library */
@@ -211,6 +229,7 @@ GuiWorld::GuiWorld(double width, double height, int numLights, int drawinterval,
 	//glfwSetCursorPosCallback( window, checkmouse );
 
 	// get key events
+	glfwSetWindowUserPointer(window, this);
 	glfwSetKeyCallback(window, key_callback);
 }
 
@@ -245,21 +264,8 @@ void GuiWorld::Step(double timestep)
 		}
 
 		// draw the goals
-		// It is imperative we use 'allGoals' here
-		// as the goal grid is not used in replays
-		for (auto &col: goals)
-		{
-			for (auto &row : col)
-			{
-				for (auto &g : row)
-				{
-					if (g->fulfilled)
-						DrawBody(g->body, c_barbiepink, g->size);
-					else
-						DrawBody(g->body, c_royalblue, g->size);
-				}
-			}
-		}
+		for (auto g : goals.All())
+			DrawGoal(g, g->fulfilled ? c_barbiepink : c_royalblue);
 
 		// draw the walls
 		for (int i = 0; i < 4; i++)
@@ -321,38 +327,55 @@ void GuiWorld::Step(double timestep)
 			lights_need_redraw = false;
 
 			// draw grid of light intensity
-			//double bright[side][side];
-
-			bright.resize(side * side);
-
-			double max = 0;
-			for (int y = 0; y < side; y++)
+			// Only the cells within reach of a changed light need recomputing
+			if (brightChanges.all || bright.size() != side * side)
 			{
-				for (int x = 0; x < side; x++)
+				bright.resize(side * side);
+				if (lightField)
 				{
-					// find the world position at this grid location
-					double wx = x * dx + dx / 2.0;
-					double wy = y * dy + dy / 2.0;
-
-					bright[y * side + x] = GetLightIntensityAt(wx, wy);
-
-					// keep track of the max for normalizatioon
-					if (bright[y * side + x] > max)
-						max = bright[y * side + x];
+					SyncLightField();
+					lightField->SampleGrid(dx / 2.0, dy / 2.0, dx, dy, side, side, bright);
+				}
+				else
+					for (int y = 0; y < side; y++)
+						for (int x = 0; x < side; x++)
+							bright[y * side + x] = GetLightIntensityAt(x * dx + dx / 2.0, y * dy + dy / 2.0);
+			}
+			else
+			{
+				const double reach = width / 5.0 + 2.0 * width / sqrt(lights.size());
+				std::vector<bool> stale(side * side, false);
+				for (auto index : brightChanges.indices)
+				{
+					const double lx = lights.x[index];
+					const double ly = lights.y[index];
+					int x0 = std::max(0, int((lx - reach) / dx));
+					int x1 = std::min(int(side) - 1, int((lx + reach) / dx));
+					int y0 = std::max(0, int((ly - reach) / dy));
+					int y1 = std::min(int(side) - 1, int((ly + reach) / dy));
+					for (int y = y0; y <= y1; y++)
+						for (int x = x0; x <= x1; x++)
+							stale[y * side + x] = true;
 				}
+				for (int y = 0; y < side; y++)
+					for (int x = 0; x < side; x++)
+						if (stale[y * side + x])
+							bright[y * side + x] = GetLightIntensityAt(x * dx + dx / 2.0, y * dy + dy / 2.0);
 			}
+			brightChanges.Clear();
 
-			// scale to normalize brightness
-			for (int y = 0; y < side; y++)
-				for (int x = 0; x < side; x++)
-					bright[y * side + x] /= (1.5 * max); // actually a little less than full alpha
+			// keep track of the max for normalizatioon
+			brightMax = 0;
+			for (size_t i = 0; i < bright.size(); i++)
+				if (bright[i] > brightMax)
+					brightMax = bright[i];
 		}
 
 		// draw the light sources
-		for (const auto &l : lights)
+		for (size_t i = 0; i < lights.size(); i++)
 		{
-			glColor4f(1, 1, 0, l->intensity);
-			DrawDisk(l->x, l->y, 0.05, NULL, true);
+			glColor4f(1, 1, 0, lights.intensity[i]);
+			DrawDisk(lights.x[i], lights.y[i], 0.05, NULL, true);
 		}
 
 		for (int y = 0; y < side; y++)
@@ -362,7 +385,9 @@ void GuiWorld::Step(double timestep)
 				double wx = x * dx + dx / 2.0;
 				double wy = y * dy + dy / 2.0;
 
-				glColor4f(1, 1, 0, bright[y * side + x]);
+				// scale to normalize brightness
+				// actually a little less than full alpha
+				glColor4f(1, 1, 0, bright[y * side + x] / (1.5 * brightMax));
 
 				glRectf(wx - dx / 2.0, wy - dy / 2.0,
 						wx + dx / 2.0, wy + dy / 2.0);
@@ -0,0 +1,239 @@
+#include "push.hh"
+
+// The irradiance map splits every light tile into sub x sub sample cells.
+// The corners of those cells form a (sub+1) x (sub+1) lattice per tile,
+// and every corner is evaluated with the same neighbourhood window that
+// World::GetExactLightIntensityAt would use for a point inside the tile,
+// so bilinear lookups never mix windows.
+//
+// Since the window is tile-aligned, the field is a stack of images: one
+// per lattice position, each the intensity grid convolved with its own
+// precomputed kernel. Changing a light adds a scaled copy of the kernel
+// to every image, one contiguous row at a time.
+
+LightField::LightField(World &world, int subdivisions) : world(world),
+                                                         sub(subdivisions)
+{
+  lside = sqrt(world.lights.size());
+  scale = (double)lside / world.width;
+  maxdist = world.width / 5.0;
+  halfwidth = maxdist * scale;
+  cellSize = (world.width / lside) / sub;
+  z = world.lights.z[0];
+  latticeSide = sub + 1;
+
+  // Light (xx,yy) is in the window of tile (lx,ly) iff
+  // -halfwidth < lx - xx <= halfwidth, so each kernel is
+  // kernelSide x kernelSide taps, indexed by lx - xx + halfwidth - 1
+  kernelSide = 2 * halfwidth;
+  kernels.resize(latticeSide * latticeSide);
+  for (int b = 0; b < latticeSide; ++b)
+    for (int a = 0; a < latticeSide; ++a)
+    {
+      std::vector<double> &k = kernels[b * latticeSide + a];
+      k.resize(kernelSide * kernelSide);
+      for (int ty = 0; ty < kernelSide; ++ty)
+        for (int tx = 0; tx < kernelSide; ++tx)
+        {
+          // Corner minus light centre, in world units
+          const double dx = (tx - halfwidth + 1) * (world.width / lside) + (a - sub / 2.0) * cellSize;
+          const double dy = (ty - halfwidth + 1) * (world.width / lside) + (b - sub / 2.0) * cellSize;
+          double value = 0;
+          // Same cutoff as the exact integral
+          if (fabs(dx) <= maxdist && fabs(dy) <= maxdist)
+            value = Kernel(dx, dy);
+          k[ty * kernelSide + tx] = value;
+        }
+    }
+
+  // Bilinear interpolation of a smooth f over an h x h cell is off by at
+  // most h^2/8 * (max|f_xx| + max|f_yy|). The kernel is sharpest right
+  // under the light, so a fine scan near the origin finds its curvature.
+  const double step = z / 64.0;
+  curvature = 0;
+  for (double dy = -2 * z; dy <= 2 * z; dy += step)
+    for (double dx = -2 * z; dx <= 2 * z; dx += step)
+    {
+      const double k = Kernel(dx, dy);
+      const double kxx = fabs(Kernel(dx + step, dy) - 2 * k + Kernel(dx - step, dy)) / (step * step);
+      const double kyy = fabs(Kernel(dx, dy + step) - 2 * k + Kernel(dx, dy - step)) / (step * step);
+      curvature = fmax(curvature, kxx + kyy);
+    }
+
+  // A light can only cross the maxdist cutoff inside a window if the
+  // window reaches more than half a tile past it
+  cutoffReachable = (maxdist * scale - halfwidth) < 0.5;
+  cutoffKernel = Kernel(maxdist, 0);
+
+  Rebuild();
+}
+
+double LightField::Kernel(double dx, double dy) const
+{
+  // Matches the per-light term in World::GetExactLightIntensityAt
+  const double distsquared = dx * dx + dy * dy + z * z;
+  const double theta = atan2(z, hypot(dx * dx, dy * dy));
+  return sin(theta) / distsquared;
+}
+
+void LightField::Rebuild()
+{
+  const size_t tiles = lside * lside;
+  planes.assign(latticeSide * latticeSide, std::vector<double>(tiles, 0.0));
+  lit.assign(tiles, 0.0);
+
+  applied.resize(tiles);
+  litLights = 0;
+  for (size_t i = 0; i < tiles; ++i)
+  {
+    applied[i] = world.lights.intensity[i];
+    if (applied[i] != 0)
+      ++litLights;
+  }
+
+  // The exact integral never reaches the last row or column of lights
+  std::vector<double> image(tiles, 0.0);
+  for (int yy = 0; yy < lside - 1; ++yy)
+    for (int xx = 0; xx < lside - 1; ++xx)
+      image[yy * lside + xx] = applied[yy * lside + xx];
+
+  // Convolve. Most of an arena is dark, so only lit pixels are scattered
+  for (int yy = 0; yy < lside - 1; ++yy)
+    for (int xx = 0; xx < lside - 1; ++xx)
+      if (image[yy * lside + xx] != 0)
+        Scatter(xx, yy, image[yy * lside + xx]);
+
+  // The window sums are a box filter, so use a summed-area table
+  std::vector<double> sat((lside + 1) * (lside + 1), 0.0);
+  for (int yy = 0; yy < lside; ++yy)
+    for (int xx = 0; xx < lside; ++xx)
+      sat[(yy + 1) * (lside + 1) + xx + 1] = fabs(image[yy * lside + xx]) + sat[yy * (lside + 1) + xx + 1] + sat[(yy + 1) * (lside + 1) + xx] - sat[yy * (lside + 1) + xx];
+
+  for (int ly = 0; ly < lside; ++ly)
+    for (int lx = 0; lx < lside; ++lx)
+    {
+      const int x0 = std::max(0, lx - halfwidth);
+      const int x1 = std::min(lside - 1, lx + halfwidth);
+      const int y0 = std::max(0, ly - halfwidth);
+      const int y1 = std::min(lside - 1, ly + halfwidth);
+      if (x1 <= x0 || y1 <= y0)
+        continue;
+      lit[ly * lside + lx] = sat[y1 * (lside + 1) + x1] - sat[y0 * (lside + 1) + x1] - sat[y1 * (lside + 1) + x0] + sat[y0 * (lside + 1) + x0];
+    }
+}
+
+void LightField::Refresh(const LightChanges &changes)
+{
+  // Patching costs about as much per changed light as a rebuild does per lit one
+  if (changes.all || changes.indices.size() > litLights)
+  {
+    Rebuild();
+    return;
+  }
+
+  for (auto index : changes.indices)
+  {
+    const double before = applied[index];
+    const double after = world.lights.intensity[index];
+    if (before == after)
+      continue;
+    applied[index] = after;
+    litLights += (after != 0) - (before != 0);
+
+    const int xx = index % lside;
+    const int yy = index / lside;
+
+    // The exact integral never reaches the last row or column of lights
+    if (xx >= lside - 1 || yy >= lside - 1)
+      continue;
+
+    Scatter(xx, yy, after - before);
+    Widen(xx, yy, fabs(after) - fabs(before));
+  }
+}
+
+void LightField::Widen(int xx, int yy, double litDelta)
+{
+  const int lxmin = std::max(0, xx - halfwidth + 1);
+  const int lxmax = std::min(lside - 1, xx + halfwidth);
+  const int lymin = std::max(0, yy - halfwidth + 1);
+  const int lymax = std::min(lside - 1, yy + halfwidth);
+  for (int ly = lymin; ly <= lymax; ++ly)
+  {
+    double *row = &lit[ly * lside];
+    for (int lx = lxmin; lx <= lxmax; ++lx)
+      row[lx] += litDelta;
+  }
+}
+
+void LightField::Scatter(int xx, int yy, double delta)
+{
+  // Tiles whose window contains light (xx,yy)
+  const int lxmin = std::max(0, xx - halfwidth + 1);
+  const int lxmax = std::min(lside - 1, xx + halfwidth);
+  const int lymin = std::max(0, yy - halfwidth + 1);
+  const int lymax = std::min(lside - 1, yy + halfwidth);
+  const int count = lxmax - lxmin + 1;
+
+  for (size_t p = 0; p < planes.size(); ++p)
+  {
+    const double *k = &kernels[p][0];
+    double *plane = &planes[p][0];
+    for (int ly = lymin; ly <= lymax; ++ly)
+    {
+      // Both rows are contiguous, so this is a plain axpy
+      double *row = plane + ly * lside + lxmin;
+      const double *krow = k + (ly - yy + halfwidth - 1) * kernelSide + (lxmin - xx + halfwidth - 1);
+      for (int i = 0; i < count; ++i)
+        row[i] += delta * krow[i];
+    }
+  }
+}
+
+double LightField::Sample(double x, double y, double *bound) const
+{
+  const double fu = x * scale * sub;
+  const double fv = y * scale * sub;
+
+  // Outside the grid we have no samples; fall back to the exact integral
+  if (fu < 0 || fv < 0 || fu >= lside * sub || fv >= lside * sub)
+  {
+    if (bound)
+      *bound = 0;
+    return world.GetExactLightIntensityAt(x, y);
+  }
+
+  const int ci = fu;
+  const int cj = fv;
+  const double tx = fu - ci;
+  const double ty = fv - cj;
+
+  // Tile, and the cell's lower left corner on that tile's lattice
+  const int tile = (cj / sub) * lside + ci / sub;
+  const int a = ci % sub;
+  const int b = cj % sub;
+  const int p = b * latticeSide + a;
+
+  if (bound)
+  {
+    *bound = cellSize * cellSize / 8.0 * curvature * lit[tile];
+    if (cutoffReachable)
+      *bound += cutoffKernel * lit[tile];
+  }
+
+  const double c00 = planes[p][tile];
+  const double c10 = planes[p + 1][tile];
+  const double c01 = planes[p + latticeSide][tile];
+  const double c11 = planes[p + latticeSide + 1][tile];
+  const double bottom = c00 + tx * (c10 - c00);
+  const double top = c01 + tx * (c11 - c01);
+  return bottom + ty * (top - bottom);
+}
+
+void LightField::SampleGrid(double x0, double y0, double dx, double dy, size_t nx, size_t ny, std::vector<double> &out) const
+{
+  out.resize(nx * ny);
+  for (size_t j = 0; j < ny; ++j)
+    for (size_t i = 0; i < nx; ++i)
+      out[j * nx + i] = Sample(x0 + i * dx, y0 + j * dy, NULL);
+}
@@ -1,13 +1,13 @@
 #include "push.hh"
 #include <limits>
 
-Polygon::Polygon(double newCx, double newCy)
+Polygon::Polygon(double newCx, double newCy) : outlineStale(true), bucketsStale(true), outlineW(0), outlineH(0), outlineBand(0)
 {
     cx = newCx;
     cy = newCy;
 }
 
-Polygon::Polygon(std::vector<Vertex> newV, double newCx, double newCy)
+Polygon::Polygon(std::vector<Vertex> newV, double newCx, double newCy) : outlineStale(true), bucketsStale(true), outlineW(0), outlineH(0), outlineBand(0)
 {
     cx = newCx;
     cy = newCy;
@@ -15,7 +15,7 @@ Polygon::Polygon(std::vector<Vertex> newV, double newCx, double newCy)
     std::move(newV.begin(), it, std::back_inserter(vertices));
 }
 
-Polygon::Polygon(Polygon& poly)
+Polygon::Polygon(Polygon& poly) : outlineStale(true), bucketsStale(true), outlineW(0), outlineH(0), outlineBand(0)
 {
     cx = poly.cx;
     cy = poly.cy;
@@ -27,6 +27,7 @@ void Polygon::addVertex(double x, double y, bool userVert)
 {
     Vertex point(x, y, userVert);
     vertices.push_back(point);
+    outlineStale = bucketsStale = true;
 }
 
 void Polygon::translate(double dx, double dy, bool recenter)
@@ -41,6 +42,7 @@ void Polygon::translate(double dx, double dy, bool recenter)
         cx += dx;
         cy += dy;
     }
+    outlineStale = bucketsStale = true;
 }
 
 // [s]cale, (cx,cy) center we scale with respect to
@@ -51,6 +53,7 @@ void Polygon::scale(double s, double newCx, double newCy)
         vertex.x = (vertex.x - newCx)*s + newCx;
         vertex.y = (vertex.y - newCy)*s + newCy;
     }
+    outlineStale = bucketsStale = true;
 }
 
 // Default to user center
@@ -61,6 +64,7 @@ void Polygon::scale(double s)
         vertex.x = (vertex.x - cx)*s + cx;
         vertex.y = (vertex.y - cy)*s + cy;
     }
+    outlineStale = bucketsStale = true;
 }
 
 double Polygon::getArea()
@@ -124,56 +128,57 @@ Vertex Polygon::getCentroid()
     return centroid;
 }
 
+// Shortest distance from (x,y) to the segment (x1,y1)-(x2,y2)
+static double segmentDist(double x, double y, double x1, double y1, double x2, double y2)
+{
+    // We could do this in a lot fewer variables
+    // but this algorithm is kind of arcane
+    double A, B, C, D, dot, lenSq, check, xx, yy, dx, dy;
+
+    A = x - x1;
+    B = y - y1;
+    C = x2 - x1;
+    D = y2 - y1;
+
+    dot = A*C + B*D;
+    lenSq = C*C + D*D;
+    check = -1;
+
+    if (lenSq != 0)
+        check = dot / lenSq;
+
+    if (check < 0) { // Closest to first point
+        xx = x1;
+        yy = y1;
+    }
+    else if (check > 1) { // Closest to seconds
+        xx = x2;
+        yy = y2;
+    }
+    else { // Closest to segment on the line
+        xx = x1 + check * C;
+        yy = y1 + check * D;
+    }
+
+    dx = x - xx;
+    dy = y - yy;
+    return sqrt(dx * dx + dy * dy);
+}
+
 // x,y is the point
 double Polygon::getDistFromPoint(double x, double y)
 {
     // Calculate the distance from the point to the polygon
     // Loop over all line segments and take the min
-
-    // We could do this in a lot fewer variables
-    // but this algorithm is kind of arcane
-    double A, B, C, D, dot, lenSq, check, xx, yy, x1, y1, x2, y2, dx, dy, dist;
+    double dist;
     double minDistance = std::numeric_limits<double>::infinity();
 
-    int length = vertices.size(); // save a function call each loop
     int iplus1;
     for (int i = 0; i < vertices.size(); ++i)
     {
         // This accounts for the fact that we want i+1 = 0 at the last i
         iplus1 = (i+1) % vertices.size();
-        x1 = vertices[i].x;
-        y1 = vertices[i].y;
-        x2 = vertices[iplus1].x;
-        y2 = vertices[iplus1].y;
-
-        A = x - x1;
-        B = y - y1;
-        C = x2 - x1;
-        D = y2 - y1;
-
-        dot = A*C + B*D;
-        lenSq = C*C + D*D;
-        check = -1;
-
-        if (lenSq != 0)
-            check = dot / lenSq;
-
-        if (check < 0) { // Closest to first point
-            xx = x1;
-            yy = y1;
-        }
-        else if (check > 1) { // Closest to seconds
-            xx = x2;
-            yy = y2;
-        }
-        else { // Closest to segment on the line
-            xx = x1 + check * C;
-            yy = y1 + check * D;
-        }
-
-        dx = x - xx;
-        dy = y - yy;
-        dist = sqrt(dx * dx + dy * dy);
+        dist = segmentDist(x, y, vertices[i].x, vertices[i].y, vertices[iplus1].x, vertices[iplus1].y);
         if(dist < minDistance)
         {
             minDistance = dist;
@@ -182,6 +187,131 @@ double Polygon::getDistFromPoint(double x, double y)
     return minDistance;
 }
 
+void Polygon::rasterizeOutline(int w, int h, double band)
+{
+    if (!outlineStale && w == outlineW && h == outlineH && band == outlineBand)
+        return;
+
+    // Forget only what the last raster touched
+    if (outline.size() != (size_t)(w * h))
+    {
+        outline.assign(w * h, std::numeric_limits<double>::infinity());
+        outlineTouched.clear();
+    }
+    for (auto cell : outlineTouched)
+        outline[cell] = std::numeric_limits<double>::infinity();
+    outlineTouched.clear();
+
+    // A point within the band of the outline is within the band of its
+    // closest edge, so stamping each edge's own neighbourhood finds the
+    // same minimum getDistFromPoint would
+    int iplus1;
+    for (int i = 0; i < vertices.size(); ++i)
+    {
+        iplus1 = (i+1) % vertices.size();
+        const Vertex &a = vertices[i];
+        const Vertex &b = vertices[iplus1];
+        int x0 = std::max(0.0, floor(fmin(a.x, b.x) - band));
+        int x1 = std::min(w - 1.0, ceil(fmax(a.x, b.x) + band));
+        int y0 = std::max(0.0, floor(fmin(a.y, b.y) - band));
+        int y1 = std::min(h - 1.0, ceil(fmax(a.y, b.y) + band));
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+            {
+                double dist = segmentDist(x, y, a.x, a.y, b.x, b.y);
+                if (dist >= band)
+                    continue;
+                double &cell = outline[y * w + x];
+                if (cell == std::numeric_limits<double>::infinity())
+                    outlineTouched.push_back(y * w + x);
+                if (dist < cell)
+                    cell = dist;
+            }
+    }
+
+    outlineW = w;
+    outlineH = h;
+    outlineBand = band;
+    outlineStale = false;
+}
+
+const std::vector<int>& Polygon::getOutlineCells()
+{
+    return outlineTouched;
+}
+
+double Polygon::getOutlineDist(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= outlineW || y >= outlineH)
+        return std::numeric_limits<double>::infinity();
+    return outline[y * outlineW + x];
+}
+
+double Polygon::getNearestConvexDistSq(double x, double y, double limit)
+{
+    if (bucketsStale)
+        bucketConvexVertices();
+
+    // Search rings of buckets outwards until no closer vertex can exist
+    int bx = std::max(0, std::min(bucketsPerSide - 1, (int)floor((x - bucketMinX) / bucketSize)));
+    int by = std::max(0, std::min(bucketsPerSide - 1, (int)floor((y - bucketMinY) / bucketSize)));
+    double minDist = limit;
+    for (int ring = 0; ring < bucketsPerSide; ++ring)
+    {
+        for (int j = by - ring; j <= by + ring; ++j)
+            for (int i = bx - ring; i <= bx + ring; ++i)
+            {
+                if (i < 0 || j < 0 || i >= bucketsPerSide || j >= bucketsPerSide)
+                    continue;
+                if (abs(i - bx) != ring && abs(j - by) != ring)
+                    continue; // inner rings are done
+                for (auto v : convexBuckets[j * bucketsPerSide + i])
+                {
+                    // Use squared distance since we only care about order
+                    double dist = ((x - vertices[v].x) * (x - vertices[v].x)) + ((y - vertices[v].y) * (y - vertices[v].y));
+                    if (dist < minDist)
+                        minDist = dist;
+                }
+            }
+        // Anything in the next ring is at least this far away
+        double reach = ring * bucketSize;
+        if (reach * reach >= minDist)
+            break;
+    }
+    return minDist;
+}
+
+void Polygon::bucketConvexVertices()
+{
+    bucketMinX = std::numeric_limits<double>::infinity();
+    bucketMinY = std::numeric_limits<double>::infinity();
+    double maxX = -1 * std::numeric_limits<double>::infinity();
+    double maxY = -1 * std::numeric_limits<double>::infinity();
+    for (auto &v : vertices)
+    {
+        bucketMinX = fmin(bucketMinX, v.x);
+        bucketMinY = fmin(bucketMinY, v.y);
+        maxX = fmax(maxX, v.x);
+        maxY = fmax(maxY, v.y);
+    }
+
+    // About one vertex per bucket
+    bucketsPerSide = std::max(1, (int)ceil(sqrt(vertices.size())));
+    bucketSize = fmax(maxX - bucketMinX, maxY - bucketMinY) / bucketsPerSide + 1e-9;
+
+    convexBuckets.assign(bucketsPerSide * bucketsPerSide, std::vector<int>());
+    for (int i = 0; i < vertices.size(); ++i)
+    {
+        //if (vertices[i].userVert)
+        if (vertices[i].concave)
+            continue;
+        int bx = std::min(bucketsPerSide - 1, (int)floor((vertices[i].x - bucketMinX) / bucketSize));
+        int by = std::min(bucketsPerSide - 1, (int)floor((vertices[i].y - bucketMinY) / bucketSize));
+        convexBuckets[by * bucketsPerSide + bx].push_back(i);
+    }
+    bucketsStale = false;
+}
+
 double Polygon::getAvgDistFromPoint(double x, double y)
 {
     double totalDist = 0;
@@ -262,6 +392,7 @@ void Polygon::primeCorners(double flare)
         vertices[2*i].x *= scales[i];
         vertices[2*i].y *= scales[i];
     }
+    outlineStale = bucketsStale = true;
 }
 
 // Uses ray-casting algorithm
@@ -313,4 +444,5 @@ void Polygon::markConcavePoints()
         else
             vertices[i].concave = false;
     }
+    outlineStale = bucketsStale = true;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "push.hh"
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+
+static const char *phaseNames[StepProfiler::PHASES] = {
+    "Sense", "Control", "Physics", "Collide", "Solve", "SolveInitSum", "SolveVelocitySum",
+    "SolvePositionSum", "Broadphase", "SolveTOI", "Settle", "Pattern", "Evaluate", "Replay"};
+
+StepProfiler::StepProfiler()
+{
+  memset(phases, 0, sizeof(phases));
+}
+
+void StepProfiler::Add(Phase phase, double ms)
+{
+  Histogram &h = phases[phase];
+  h.min = h.calls ? std::min(h.min, ms) : ms;
+  h.max = h.calls ? std::max(h.max, ms) : ms;
+  h.total += ms;
+  ++h.calls;
+
+  int bucket = 0;
+  for (double limit = 0.001; bucket < BUCKETS - 1 && ms >= limit; limit *= 2)
+    ++bucket;
+  ++h.buckets[bucket];
+}
+
+void StepProfiler::AddPhysics(const b2Profile &profile)
+{
+  Add(COLLIDE, profile.collide);
+  Add(SOLVE, profile.solve);
+  Add(SOLVE_INIT, profile.solveInit);
+  Add(SOLVE_VELOCITY, profile.solveVelocity);
+  Add(SOLVE_POSITION, profile.solvePosition);
+  Add(BROADPHASE, profile.broadphase);
+  Add(SOLVE_TOI, profile.solveTOI);
+}
+
+std::string StepProfiler::Header()
+{
+  std::ostringstream out;
+  out << "Step\tPhase\tCalls\tTotalMs\tMeanMs\tMinMs\tMaxMs";
+  for (int i = 0; i < BUCKETS - 1; ++i)
+    out << "\t<" << (1UL << i) << "us";
+  out << "\t>=" << (1UL << (BUCKETS - 2)) << "us\n";
+  return out.str();
+}
+
+std::string StepProfiler::Table(uint64_t step)
+{
+  std::ostringstream out;
+  for (int p = 0; p < PHASES; ++p)
+  {
+    const Histogram &h = phases[p];
+    if (h.calls == 0)
+      continue;
+    out << step << "\t" << phaseNames[p] << "\t" << h.calls << "\t" << h.total << "\t"
+        << h.total / h.calls << "\t" << h.min << "\t" << h.max;
+    for (int i = 0; i < BUCKETS; ++i)
+      out << "\t" << h.buckets[i];
+    out << "\n";
+  }
+  memset(phases, 0, sizeof(phases));
+  return out.str();
+}
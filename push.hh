@@ -1,8 +1,17 @@
 #include <Box2D/Box2D.h>
 #include <GLFW/glfw3.h>
 //#include "b2dJson/b2dJson.h"
+#include <stdint.h>
 #include <vector>
 #include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <new>
+#include <utility>
 
 // Note that the headers for are all push source files are found here
 
@@ -16,6 +25,7 @@ enum _entityCategory
 };
 
 class Robot;
+class Goal;
 
 class Light
 {
@@ -29,6 +39,133 @@ public:
   }
 };
 
+// All of a world's lights, one array per field, so the sensing loops
+// walk memory in order. A light's handle is its index, which is also
+// the index the replay files use
+class LightTable
+{
+public:
+  std::vector<double> x, y, z; // z is height above the arena
+  std::vector<double> intensity;
+
+  size_t size() const { return x.size(); }
+
+  size_t Add(const Light &light)
+  {
+    x.push_back(light.x);
+    y.push_back(light.y);
+    z.push_back(light.z);
+    intensity.push_back(light.intensity);
+    return x.size() - 1;
+  }
+};
+
+// Objects of one type packed into blocks that never move, so pointers
+// to them stay valid. Deleted slots are reused, and the blocks are all
+// released together. Delete what's still alive before the pool goes
+template <class T>
+class Pool
+{
+public:
+  explicit Pool(size_t blockSize = 256) : blockSize(blockSize), used(blockSize)
+  {
+  }
+
+  ~Pool()
+  {
+    for (auto block : blocks)
+      ::operator delete(block);
+  }
+
+  template <class... Args>
+  T *New(Args &&... args)
+  {
+    T *slot;
+    if (!freed.empty())
+    {
+      slot = freed.back();
+      freed.pop_back();
+    }
+    else
+    {
+      if (used == blockSize)
+      {
+        blocks.push_back((T *)::operator new(blockSize * sizeof(T)));
+        used = 0;
+      }
+      slot = blocks.back() + used++;
+    }
+    return new (slot) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T *object)
+  {
+    if (!object)
+      return;
+    object->~T();
+    freed.push_back(object);
+  }
+
+private:
+  size_t blockSize;
+  size_t used; // Slots handed out from the last block
+  std::vector<T *> blocks;
+  std::vector<T *> freed;
+
+  Pool(const Pool &);
+  Pool &operator=(const Pool &);
+};
+
+// Goals bucketed by cell in one flat table, CSR style: the goals in cell
+// c are sorted[cellStart[c]] up to sorted[cellStart[c + 1]]. Cells run
+// column by column, the order the old nested vectors were walked in.
+// Adding goals only marks the table stale; the next lookup rebuilds it
+// with a counting sort
+class GoalGrid
+{
+public:
+  GoalGrid(double width, double height, double cellSize = 1.0);
+
+  // Coarser cells for bigger boxes. Doesn't change what Match finds
+  void SetCellSize(double cellSize);
+
+  void Add(Goal *goal);
+  void Clear(); // Forgets the goals, doesn't delete them
+
+  size_t size() const { return goals.size(); }
+
+  // In the order they were added
+  const std::vector<Goal *> &All() const { return goals; }
+
+  // Cell by cell
+  const std::vector<Goal *> &Sorted();
+
+  void Unfulfill();
+
+  // Pairs positions with goals within @radius so that as many goals as
+  // possible are fulfilled, and returns how many are. Starts from the
+  // last call's pairs that still hold, so a few moved boxes are cheap
+  size_t Match(const std::vector<b2Vec2> &positions, double radius);
+
+private:
+  double width, height, cellSize;
+  int cols, rows;
+  std::vector<Goal *> goals;
+  std::vector<Goal *> sorted;
+  std::vector<uint32_t> cellStart;
+  bool stale;
+
+  // Hopcroft-Karp state. Goals are indices into sorted, -1 is unpaired
+  std::vector<uint32_t> edgeStart, edges, edgeNext;
+  std::vector<int> boxGoal, goalBox, layer, queue;
+
+  int Column(double x) const;
+  int Row(double y) const;
+  void Rebuild();
+  bool Layer();
+  bool Augment(int box);
+};
+
 class Vertex
 {
 public:
@@ -54,7 +191,7 @@ public:
 
   double cx, cy; // center
 
-  Polygon()
+  Polygon() : outlineStale(true), bucketsStale(true), outlineW(0), outlineH(0), outlineBand(0)
   {
     cx = 0;
     cy = 0;
@@ -93,11 +230,441 @@ public:
 
   // Uses ray-casting algorithm
   bool pointInsidePoly(double x, double y);
+
+  // Rasterise getDistFromPoint over the integer points of a @w by @h grid,
+  // keeping only distances below @band. Only edge neighbourhoods are
+  // visited, and nothing is redone until the polygon moves
+  void rasterizeOutline(int w, int h, double band);
+
+  // Distance from integer point (x,y) to the outline, as of the last
+  // rasterizeOutline; infinity if it was outside the band
+  double getOutlineDist(int x, int y);
+
+  // Grid indices (y * w + x) of the points within the band
+  const std::vector<int>& getOutlineCells();
+
+  // Smallest squared distance from (x,y) to a vertex not marked concave,
+  // or @limit if every such vertex is further
+  double getNearestConvexDistSq(double x, double y, double limit);
+
+private:
+  // Cached outline raster and vertex buckets. Anything that moves the
+  // vertices through the methods above marks them stale
+  bool outlineStale, bucketsStale;
+  int outlineW, outlineH;
+  double outlineBand;
+  std::vector<double> outline;
+  std::vector<int> outlineTouched;
+
+  std::vector<std::vector<int>> convexBuckets;
+  int bucketsPerSide;
+  double bucketSize, bucketMinX, bucketMinY;
+
+  void bucketConvexVertices();
 };
 
 class Robot;
 class Box;
 class Goal;
+class LightField;
+
+// Collects the indices of lights whose intensity changed,
+// until the consumer clears it
+class LightChanges
+{
+public:
+  std::vector<size_t> indices;
+  bool all; // Everything is stale, e.g. nobody has looked yet
+
+  LightChanges() : all(true)
+  {
+  }
+
+  void Mark(size_t index);
+  void Clear();
+  bool Empty() const { return !all && indices.empty(); }
+
+private:
+  std::vector<bool> marked;
+};
+
+// Counter-based random numbers. Each stream is independent of every
+// other and of the order streams are drawn from, so a run is repeatable
+// from its seed alone, however the work is split across threads
+class Rng
+{
+public:
+  // Stream numbers. Robot i draws from STREAM_ROBOT + i
+  enum
+  {
+    STREAM_SCENARIO = 0, // initial placement and goal layout
+    STREAM_PATTERN,      // light pattern
+    STREAM_ROBOT
+  };
+
+  Rng(uint64_t seed = 0, uint64_t stream = 0);
+
+  void Seed(uint64_t seed, uint64_t stream);
+
+  uint64_t Next();
+
+  // Uniform in [0, 1)
+  double Uniform();
+
+  // Uniform integer in [0, n)
+  size_t Below(size_t n);
+
+private:
+  uint64_t key;
+  uint64_t counter;
+};
+
+// A fixed set of threads that split a range of independent jobs.
+// The calling thread takes a share too, so a pool of n threads runs
+// n + 1 slices at once
+class WorkerPool
+{
+public:
+  WorkerPool(size_t threads);
+  ~WorkerPool();
+
+  // Call @job(begin, end) on contiguous slices covering [0, count),
+  // and return once every slice is done. Slices are fixed by @count
+  // and the pool size alone
+  void Run(size_t count, const std::function<void(size_t, size_t)> &job);
+
+  size_t Size() const { return threads.size() + 1; }
+
+private:
+  std::vector<std::thread> threads;
+  std::mutex lock;
+  std::condition_variable wake, done;
+
+  const std::function<void(size_t, size_t)> *job;
+  size_t count;
+  size_t generation; // Bumped for every Run so workers see new work
+  size_t pending;
+  bool stopping;
+
+  void Work(size_t slice);
+};
+
+// Hands Box2D's independent work, such as its islands, to a WorkerPool
+class WorkerTasks : public b2TaskRunner
+{
+public:
+  WorkerPool *pool;
+
+  WorkerTasks() : pool(NULL) {}
+
+  virtual void ParallelFor(int32 count, void (*task)(int32 begin, int32 end, void *context), void *context)
+  {
+    pool->Run(count, [=](size_t begin, size_t end) { task(begin, end, context); });
+  }
+};
+
+// Puts boxes at rest inside the goal to sleep. Box2D only sleeps whole
+// islands, and the robots keep shoving the edge of the packed boxes, so
+// they would all stay awake in one big island. A settled box is made
+// static instead: islands stop at it and it has no contacts with the
+// other settled boxes. A robot hitting it harder than wakeImpulse makes
+// it dynamic again
+class BoxSettler : public b2ContactListener
+{
+public:
+  double wakeImpulse;
+
+  BoxSettler(double wakeImpulse) : wakeImpulse(wakeImpulse) {}
+
+  // Call after each step. Boxes inside the goal settle once they have
+  // stayed under Box2D's sleep tolerances for b2_timeToSleep seconds
+  void Update(std::vector<Box *> &boxes, double timestep);
+
+  // Called during b2World::Step, from the worker threads for islands
+  // without a static body. Those can't touch a settled box, so only
+  // the serial islands record anything
+  virtual void PostSolve(b2Contact *contact, const b2ContactImpulse *impulse);
+
+private:
+  std::vector<Box *> hit; // Settled boxes to wake after this step
+};
+
+// Time spent in each part of a run, as a histogram per part over the
+// steps since the last Table. Each is wall clock time, except the solve
+// sub-phases marked below
+class StepProfiler
+{
+public:
+  enum Phase
+  {
+    SENSE = 0, // World::SenseLights
+    CONTROL,   // Robot::Update and ApplySpeed
+    PHYSICS,   // b2World::Step, broken down by its b2Profile below
+    COLLIDE,
+    SOLVE,
+    SOLVE_INIT,     // These three are summed over the islands, which
+    SOLVE_VELOCITY, // b2World solves on several threads at once, so with
+    SOLVE_POSITION, // -j above 1 they can add up to more than SOLVE
+    BROADPHASE,
+    SOLVE_TOI,
+    SETTLE,   // BoxSettler::Update
+    PATTERN,  // Simulation::UpdatePattern
+    EVALUATE, // Success measures
+    REPLAY,   // World::appendWorldStateToFile
+    PHASES
+  };
+
+  // Bucket i counts the times under 2^i microseconds that didn't fit
+  // bucket i-1. The last takes everything longer
+  static const int BUCKETS = 20;
+
+  StepProfiler();
+
+  void Add(Phase phase, double ms);
+
+  // The physics sub-phases b2World::Step measured itself
+  void AddPhysics(const b2Profile &profile);
+
+  // The column names for Table
+  static std::string Header();
+
+  // One row per phase that ran since the last call, labelled @step,
+  // then start again
+  std::string Table(uint64_t step);
+
+  // The milliseconds spent in @phase since the last Table
+  double Total(Phase phase) const { return phases[phase].total; }
+
+private:
+  struct Histogram
+  {
+    uint64_t calls;
+    double total, min, max; // ms
+    uint64_t buckets[BUCKETS];
+  };
+  Histogram phases[PHASES];
+};
+
+// An output file that stays open for the whole run. Writes collect in
+// a large buffer that goes to disk when full or at Flush; with a
+// background thread, the thread does the writing and Flush returns
+// straight away
+class BufferedFile
+{
+public:
+  BufferedFile(const std::string &fileName, bool truncate, bool background, size_t bufferSize = 1 << 20);
+  ~BufferedFile();
+
+  bool IsOpen() const { return fd >= 0; }
+
+  void Write(const void *data, size_t bytes);
+  void Write(const std::string &text);
+
+  // Size of the file once everything written so far is out
+  uint64_t Offset() const { return offset; }
+
+  // Send the buffer on its way
+  void Flush();
+
+  // Flush, and wait until everything is on disk
+  void Sync();
+
+  void Close();
+
+private:
+  int fd;
+  size_t bufferSize;
+  uint64_t offset;
+  std::string buffer;
+
+  std::thread writer;
+  std::mutex lock;
+  std::condition_variable wake, drained;
+  std::deque<std::string> queue;
+  bool busy;
+  bool stopping;
+
+  void WriteOut(const std::string &data);
+  void WriterLoop();
+};
+
+// Binary replays. The file starts with the same text header as a text
+// replay, so the options can be read back the same way, followed by
+// tagged records: goals, frames, the success measure, and finally a
+// frame index. Everything is written in the machine's byte order
+struct ReplayRobot
+{
+  float x, y, a, charge;
+};
+
+struct ReplayBox
+{
+  float x, y, a;
+  uint32_t insidePoly;
+};
+
+struct ReplayLight
+{
+  uint32_t index;
+  float intensity;
+};
+
+// Quantised poses. Positions are fractions of the arena and angles
+// fractions of a turn, in 16 bit fixed point
+struct QuantRobot
+{
+  uint32_t index;
+  uint16_t x, y, a, charge;
+};
+
+struct QuantBox
+{
+  uint32_t index;
+  uint16_t x, y, a, insidePoly;
+};
+
+struct ReplayGoal
+{
+  float x, y, size;
+  int32_t shape;
+};
+
+class ReplayWriter
+{
+public:
+  // Appends to @fileName, which should already hold the text header.
+  // Every @keyInterval frames all lit lights are written rather than
+  // just the changes, so a reader never replays more than that many
+  ReplayWriter(const std::string &fileName, size_t robots, size_t boxes, size_t lights, size_t keyInterval = 64);
+
+  // Appends to @file, which stays open after Close
+  ReplayWriter(BufferedFile &file, size_t robots, size_t boxes, size_t lights, size_t keyInterval = 64);
+  ~ReplayWriter();
+
+  bool IsOpen() const { return file != NULL && file->IsOpen(); }
+
+  // Store poses in 16 bit fixed point relative to the arena, and only
+  // for bodies that moved more than @tolerance steps since they were
+  // last written (keyframes hold everything). Call before any frame
+  void Quantise(float width, float height, float chargeMax, uint32_t tolerance);
+
+  void AppendGoals(const std::vector<ReplayGoal> &goals);
+
+  // @intensities holds every light; only the differences from the
+  // previous frame are stored
+  void AppendFrame(uint64_t step, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes, const std::vector<float> &intensities);
+
+  // The same, for a world that knows which lights it changed. Only the
+  // lights in @changes are looked at, apart from keyframes
+  void AppendFrame(uint64_t step, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes, const std::vector<double> &intensities, const LightChanges &changes);
+
+  void AppendSuccess(double success);
+
+  // Write the frame index and close. Readers can cope without the
+  // index, e.g. after a crash, but have to scan the file to build it
+  void Close();
+
+private:
+  BufferedFile *file;
+  bool ownsFile;
+  size_t robotCount, boxCount, lightCount;
+  size_t keyInterval;
+  uint64_t successOffset;
+  std::vector<uint64_t> frameOffsets;
+  std::vector<float> lastIntensities;
+  std::vector<ReplayLight> lightRecords;
+  std::vector<size_t> changedLights;
+
+  bool quantised;
+  float qWidth, qHeight, qChargeMax;
+  uint32_t qTolerance;
+  std::vector<QuantRobot> lastRobots;
+  std::vector<QuantBox> lastBoxes;
+
+  void Begin();
+  bool KeyFrameDue(size_t lights) const;
+  void AppendLight(uint32_t index, float intensity);
+  void AppendRecords(uint64_t step, uint32_t flags, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes);
+  void AppendQuantisedFrame(uint64_t step, uint32_t flags, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes);
+  void WriteRecord(uint32_t tag, const std::vector<std::pair<const void *, size_t>> &parts);
+};
+
+class ReplayReader
+{
+public:
+  // Maps @fileName. Check IsOpen before anything else
+  ReplayReader(const std::string &fileName);
+  ~ReplayReader();
+
+  // Whether @fileName holds a binary replay
+  static bool IsBinary(const std::string &fileName);
+
+  bool IsOpen() const { return data != NULL; }
+
+  size_t Frames() const { return frames.size(); }
+  size_t RobotCount() const { return robotCount; }
+  size_t BoxCount() const { return boxCount; }
+
+  // The state at @frame. Stepping forward one frame applies one frame
+  // of changes; any other jump starts from the last keyframe
+  uint64_t Step(size_t frame) const;
+  const ReplayRobot *Robots(size_t frame);
+  const ReplayBox *Boxes(size_t frame);
+  const std::vector<float> &Lights(size_t frame);
+
+  const std::vector<ReplayGoal> &Goals() const { return goals; }
+
+  // False if the run never recorded one
+  bool GetSuccess(double &success) const;
+
+private:
+  const char *data;
+  size_t size;
+  size_t robotCount, boxCount, lightCount;
+  size_t keyInterval;
+  bool quantised;
+  float scales[3]; // width, height, maximum charge
+  std::vector<const char *> frames;
+  std::vector<ReplayGoal> goals;
+  const char *successRecord;
+
+  std::vector<ReplayRobot> robots;
+  std::vector<ReplayBox> boxes;
+  std::vector<float> intensities;
+  long stateFrame; // The frame the state above is for, or -1
+
+  void ApplyFrame(size_t frame);
+  void Seek(size_t frame);
+};
+
+// Reads the text replay format straight out of the mapped file. Each
+// NextState fills the vectors below for the sections that state has;
+// they are reused, so reading a replay allocates nothing per frame
+class TextReplayReader
+{
+public:
+  TextReplayReader(const std::string &fileName);
+  ~TextReplayReader();
+
+  bool IsOpen() const { return data != NULL; }
+
+  // Move to the next '$'-terminated state. False once there are none
+  bool NextState();
+
+  // Which sections the current state had
+  bool hasRobots, hasBoxes, hasLights, hasGoals, hasSuccess;
+
+  std::vector<ReplayRobot> robots;
+  std::vector<ReplayBox> boxes;
+  std::vector<ReplayLight> lights; // Only the lit ones
+  std::vector<ReplayGoal> goals;
+  double success;
+
+private:
+  const char *data;
+  size_t size;
+  const char *next;
+};
 
 class World
 {
@@ -131,28 +698,96 @@ public:
 
   // Just for convenience
   // Doesn't make sense to pause a non-gui world
-  static bool paused;
-  static bool replayWorld;
+  // These belong to each world, so several can run side by side
+  bool paused;
+  bool replayWorld;
 
   // Unfortunately necessary. A replay needs to stay 'normal-paused' throughout to avoid updates
   // replay_pause let's us actually stop loading replay states
-  static bool replay_paused;
+  bool replay_paused;
+
+  // Frames to jump by in a binary replay, set from the keyboard
+  long replay_seek;
 
   size_t steps;
-  std::vector<Light *> lights;
+  LightTable lights;
   std::vector<Box *> boxes;
   std::vector<Robot *> robots;
   
   // We want to index this by position to avoid an O(n^2) checking algorithm
-  std::vector<std::vector<std::vector<Goal *>>> goals;
+  GoalGrid goals;
 
   double numGoals; // Necessary since we can't just call goals.size()
 
+  // Optional precomputed irradiance map. NULL means every query
+  // integrates over the lights directly
+  LightField *lightField;
+
+  // Every SetLightIntensity that changes a light is reported to these
+  std::vector<LightChanges *> lightWatchers;
+  LightChanges fieldChanges;
+  LightChanges replayChanges;
+
+  // Every stream is derived from this. Robots take theirs when constructed
+  uint64_t seed;
+  Rng scenarioRng;
+  Rng patternRng;
+
+  // 'T' for text replays, 'B' for binary ones, 'Q' for quantised
+  // binary ones that only store what moved
+  char replayFormat;
+  ReplayWriter *replayWriter;
+
+  // Replay and performance files, kept open by name for the whole run
+  std::map<std::string, BufferedFile *> outputs;
+  bool backgroundOutput; // Write them from a separate thread
+
+  Pool<Box> boxPool;
+  Pool<Goal> goalPool;
+
+  // Threads for the per-robot work in Step. NULL runs everything serially
+  WorkerPool *workers;
+  WorkerTasks physicsTasks; // The same threads, for b2world
+
+  BoxSettler *settler; // NULL leaves every box dynamic
+
+  StepProfiler *profiler; // NULL doesn't time anything
+
+  // Sensor positions for this step, as structure of arrays
+  std::vector<double> sensorX, sensorY, sensorReadings;
+
+  // The lights the last UpdateLightPattern turned on
+  std::vector<size_t> patternLights;
+  std::vector<int> patternStamp;
+  int patternGeneration;
+
   World(double width, double height, int numLights, int drawInterval, double flare, double drag, bool switchToCircle, bool replayWorld);
 
+  // Frees the lights, robots, boxes and goals, and the b2World with
+  // every body in it
+  virtual ~World();
+
+  // Boxes and goals are kept in pools the world owns. Make them with
+  // NewBox and NewGoal; AddBox and AddGoal only take what those return
+  template <class... Args>
+  Box *NewBox(Args &&... args)
+  {
+    Box *box = boxPool.New(*this, std::forward<Args>(args)...);
+    AddBox(box);
+    return box;
+  }
+
+  template <class... Args>
+  Goal *NewGoal(Args &&... args)
+  {
+    return goalPool.New(std::forward<Args>(args)...);
+  }
+
+  void DeleteGoal(Goal *goal) { goalPool.Delete(goal); }
+
   virtual void AddRobot(Robot *robot);
   virtual void AddBox(Box *box);
-  virtual void AddLight(Light *light);
+  virtual void AddLight(const Light &light);
   virtual void AddLightGrid(size_t xcount, size_t ycount, double height, double intensity);
   virtual void AddGoal(Goal *goal);
 
@@ -166,6 +801,15 @@ public:
   // Pull the next world state from the file
   bool loadNextState(std::ifstream& file);
 
+  // Apply whatever the reader's current state holds, as loadNextState does
+  void loadTextReplayState(TextReplayReader &replay);
+
+  // Add the goals stored in a binary replay
+  void loadReplayGoals(ReplayReader &replay);
+
+  // Put the world in the state of @frame of a binary replay
+  bool loadReplayFrame(ReplayReader &replay, size_t frame);
+
   bool loadPolygonFromFile(std::ifstream& infile);
 
   // Lets us update the pattern of light in one function call with a few parameters
@@ -179,7 +823,54 @@ public:
   void UpdateLightPattern(double goalx, double goaly, double probOn, double radius, double pattwidth, double cornerRate);
 
   // return instantaneous light intensity from all sources
-  double GetLightIntensityAt(double x, double y);
+  // Uses the irradiance map if one is enabled. If @bound is not NULL it
+  // receives the maximum error against the exact integral
+  double GetLightIntensityAt(double x, double y, double *bound = NULL);
+
+  // Integrate over the light sources directly
+  double GetExactLightIntensityAt(double x, double y);
+
+  // Fill @out with the intensities at the @count points (@x[i], @y[i]),
+  // split across the worker threads. Every reading is the value
+  // GetLightIntensityAt would give for that point
+  void GetLightIntensitiesAt(const double *x, const double *y, double *out, size_t count);
+
+  // Restart the world's random streams from @seed. Call before adding robots
+  void SetSeed(uint64_t seed);
+
+  // Use @threads threads (including the caller) for the per-robot work
+  // and for solving b2world's islands
+  void SetWorkerThreads(size_t threads);
+
+  // Settle boxes at rest inside the goal until a robot hits one with an
+  // impulse over @wakeImpulse. 0 turns settling off
+  void SetSettling(double wakeImpulse);
+
+  // Read every robot's light sensors for this step in one batch
+  void SenseLights();
+
+  // Time Step's phases, and whatever else calls Profile
+  void EnableProfiler();
+
+  // Add the time since @timer started to @phase, and restart it
+  void Profile(StepProfiler::Phase phase, b2Timer &timer)
+  {
+    if (profiler)
+    {
+      profiler->Add(phase, timer.GetMilliseconds());
+      timer.Reset();
+    }
+  }
+
+  // Append the profile since the last call to @fileName
+  void WriteProfile(const std::string &fileName);
+
+  // Answer light queries from an irradiance map with @subdivisions
+  // samples per light along each axis. Call after AddLightGrid
+  void EnableLightField(int subdivisions);
+
+  // Bring the irradiance map up to date with the lights
+  void SyncLightField();
 
   // perform one simulation step
   virtual void Step(double timestep);
@@ -192,6 +883,13 @@ public:
   // and actually set the polgyon to this size
   double GetSetRadMax(Polygon* tempPoly);
 
+  // The open output file @fileName. @truncate starts it afresh
+  BufferedFile &Output(const std::string &fileName, bool truncate = false);
+
+  // Push buffered output towards the disk, or close every output file
+  void FlushOutputs();
+  void CloseOutputs();
+
   // Saves the world state to a JSON file
   void saveWorldHeader(std::string saveFileName);
   void saveGoalsToFile(std::string saveFileName);
@@ -208,8 +906,9 @@ public:
 
   // Note that all the information we need is part of the world already
   // Hence the argumentless call
-  bool populateGoals(double RADMIN, int callNum, std::vector<Goal*>& tempGoals);
-  void recenterGoals(std::vector<Goal*>& tempGoals);
+  size_t hexCentres(double RADMIN, double scale, size_t limit, std::vector<b2Vec2> *centres);
+  bool populateGoals(double RADMIN);
+  void recenterGoals(std::vector<b2Vec2>& centres);
   void unfulfillGoals();
 
   void populateGoalPolygon(double boxArea, double robotArea, double robot_size, Polygon* realPoly);
@@ -232,15 +931,77 @@ public:
   double evaluateSuccessInsidePoly(double RADMIN, std::string perfFile);
 };
 
+// Incrementally maintained irradiance map over the light grid
+// The field is the light intensity grid convolved with a precomputed
+// kernel. Light changes are pushed in as they happen; queries are a
+// bilinear lookup
+class LightField
+{
+public:
+  LightField(World &world, int subdivisions);
+
+  // Recompute the whole field from the current light intensities
+  void Rebuild();
+
+  // Catch up with the listed light changes, patching around each one
+  // or reconvolving the whole grid, whichever is cheaper
+  void Refresh(const LightChanges &changes);
+
+  // Interpolated intensity at (x,y). If @bound is not NULL it receives
+  // an upper bound on the difference from the exact integral
+  double Sample(double x, double y, double *bound) const;
+
+  // Fill @out with an @nx by @ny grid of samples, row major, starting at (x0,y0)
+  void SampleGrid(double x0, double y0, double dx, double dy, size_t nx, size_t ny, std::vector<double> &out) const;
+
+private:
+  World &world;
+  int sub;
+  int lside;
+  int halfwidth;
+  int latticeSide; // sub + 1 sample corners along each side of a tile
+  double scale;
+  double maxdist;
+  double cellSize;
+  double z;
+
+  // One kernel and one image per corner position on the tile lattice
+  std::vector<std::vector<double>> kernels;
+  std::vector<std::vector<double>> planes;
+  int kernelSide;
+
+  // Total intensity of the lights in each tile's window
+  std::vector<double> lit;
+
+  // The intensities the field currently reflects
+  std::vector<double> applied;
+  size_t litLights;
+
+  // Error bound terms
+  double curvature;
+  bool cutoffReachable;
+  double cutoffKernel;
+
+  double Kernel(double dx, double dy) const;
+
+  // Add @delta times the kernels, centred on light (xx,yy)
+  void Scatter(int xx, int yy, double delta);
+
+  // Add @litDelta to the window sums of the tiles that see light (xx,yy)
+  void Widen(int xx, int yy, double litDelta);
+};
+
 class GuiWorld : public World
 {
 public:
-  //static bool paused;
-  static bool step;
-  static int skip;
+  // Set from the keyboard: one step while paused, and steps per redraw
+  bool step;
+  int skip;
 
   bool lights_need_redraw;
-  std::vector<double> bright;
+  std::vector<double> bright; // Raw light intensity heatmap
+  double brightMax;
+  LightChanges brightChanges;
 
   GLFWwindow *window;
 
@@ -249,7 +1010,7 @@ public:
 
   virtual void Step(double timestep);
 
-  virtual void AddLight(Light *light)
+  virtual void AddLight(const Light &light)
   {
     lights_need_redraw = true;
     World::AddLight(light);
@@ -298,7 +1059,15 @@ public:
 
   double targets[7];
 
-  static std::vector<Light> lights;
+  // Light sensor positions in the body frame. World::SenseLights reads
+  // them into sensed on the steps where SensorsDue() is true, and reads
+  // the intensity at the centre into light on every step
+  std::vector<b2Vec2> sensors;
+  std::vector<double> sensed;
+  double light;
+
+  // This robot's own random stream
+  Rng rng;
 
   b2Body *body; //, *bumper;
   //  b2PrismaticJoint* joint;
@@ -315,26 +1084,82 @@ public:
         double output_metabolic = 0.01,
         double output_efficiency = 0.1);
 
+  // The body goes with the b2World
+  virtual ~Robot() {}
+
   virtual void Update(double timestep);
 
+  // Whether Update will look at the sensors this step
+  virtual bool SensorsDue() const { return false; }
+
   //protected:
   // get sensor data
   double GetLightIntensity(void) const;
   double GetLightIntensityAt(double x, double y) const;
 
-  // send commands
+  // send commands. They are held until ApplySpeed, so that every
+  // controller sees the same world while Step runs them in parallel
   void SetSpeed(double x, double y, double a);
+  void ApplySpeed();
+
+  // Body velocities, including a command that has not been applied yet
+  b2Vec2 GetLinearVelocity() const;
+  float32 GetAngularVelocity() const;
 
 private:
+  bool speedPending;
+  bool pendingWake; // Any nonzero command wakes the body, even if overridden
+  b2Vec2 pendingLinear;
+  float32 pendingAngular;
+
   void UpdateTargetSensor(void);
 };
 
+// The robot main uses: drives along the light gradient its four
+// sensors see, at the phase it drew when it was made
+class Pusher : public Robot
+{
+private:
+  typedef enum
+  {
+    S_PUSH = 0,
+    S_BACKUP,
+    S_TURN,
+    S_COUNT,
+    S_ESCAPE
+  } control_state_t;
+
+  static const double PUSH, BACKUP, TURNMAX;
+  static const double SPEEDX, SPEEDA;
+  static const double maxspeedx, maxspeeda;
+
+  double timeleft;
+  control_state_t state;
+  double speedx, speeda;
+
+  double lastintensity;
+  double latch;
+
+  int count;
+  bool escape;
+
+  int phase;
+
+public:
+  Pusher(World &world, robot_shape_t shape, double size, double x, double y, double a);
+
+  virtual bool SensorsDue() const;
+  virtual void Update(double timestep);
+};
+
 class Box
 {
 public:
   double size;
   char cshape;
   bool insidePoly;
+  bool settled;     // Made static by BoxSettler
+  double stillTime; // Seconds at rest inside the goal
 
   typedef enum
   {
@@ -354,8 +1179,6 @@ public:
   double x, y;
   double size;
 
-  b2Body *body;
-
   typedef enum
   {
     SHAPE_RECT = 0,
@@ -367,5 +1190,103 @@ public:
 
   goal_shape_t shape;
 
-  Goal(World *world, double x, double y, double size, goal_shape_t shape);
-};
\ No newline at end of file
+  // Goals never collide with anything, so they are only geometry and
+  // stay out of the b2World
+  Goal(double x, double y, double size, goal_shape_t shape);
+
+  // Fills @verts with the corners in world coordinates and returns how
+  // many there are. Circles have none
+  int Outline(b2Vec2 verts[6]) const;
+};
+
+// Everything a run is set up from. main fills one from the command line,
+// and a sweep fills one for every point of its grid
+struct RunConfig
+{
+  double width, height;
+  size_t robots, boxes;
+  double robotSize, boxSize;
+  Robot::robot_shape_t robotType;
+  Box::box_shape_t boxType;
+  double flare, drag;
+  bool switchToCircle;
+  double timeStep;
+  uint64_t maxSteps;
+  int guiTime;
+  int lightFieldSubdivisions;
+  int threads;
+  uint64_t seed;
+  bool haveSeed;
+  char replayFormat;
+  bool backgroundOutput;
+  bool wideContacts; // Box2D solves contacts four at a time
+  double settleImpulse; // 0 = boxes never settle
+  std::string profileFile;   // Where the step profile goes, if anywhere
+  uint64_t profileInterval;  // Steps between profile rows, 0 = only at the end
+  bool verbose; // Progress on stdout
+
+  std::string polygonFile;
+  std::string outputFile;      // Replay, with its extension
+  std::string performanceFile;
+
+  RunConfig();
+};
+
+// One contraction run on a world someone else made and owns
+class Simulation
+{
+public:
+  // Steps between changes to the light pattern
+  static const int UPDATE_RATE = 100;
+
+  Simulation(World *world, const RunConfig &config);
+
+  // Place the boxes and robots, light the arena, and fit the goals and
+  // the pattern to the polygon. False if the polygon file is unusable
+  bool Populate();
+
+  // Contract and expand until maxSteps, or until the window is closed,
+  // then measure and save. Returns the fraction of boxes in the goal
+  double Run();
+
+  double GoalRadCircle() const { return goalRadCircle; }
+
+private:
+  World *world;
+  RunConfig config;
+
+  double goalx, goaly;
+  double radius, radMin, radMax, circleRadMax;
+  double pattWidth;
+  double delta, sdelta;
+  bool holdAtMin;
+  double holdTime, holdFor;
+  double goalRadCircle;
+
+  // Returns false when the step should be skipped, as main's loop used to continue
+  bool UpdatePattern();
+};
+
+// Runs every combination of a grid of options, each in its own world, a
+// few at a time, and writes a line per run to a results table
+class Sweep
+{
+public:
+  // @base supplies everything the grid doesn't vary
+  Sweep(const RunConfig &base);
+
+  // Each line of @fileName is an option letter and the values to try,
+  // for example "-f -1 1.5" or "-e 40..99". Letters: r b f d c p e.
+  // False if the file can't be read
+  bool Load(const std::string &fileName);
+
+  // Runs @threads worlds at once and writes @tableName
+  void Run(size_t threads, const std::string &tableName);
+
+  size_t Size() const { return runs.size(); }
+
+private:
+  RunConfig base;
+  std::string outputBase; // From -o, without the extension
+  std::vector<RunConfig> runs;
+};
@@ -0,0 +1,69 @@
+#include "push.hh"
+#include <math.h>
+
+// static members
+const double Pusher::PUSH = 15.0; // seconds
+const double Pusher::BACKUP = 0.5;
+const double Pusher::TURNMAX = 2;
+const double Pusher::SPEEDX = 0.5;
+const double Pusher::SPEEDA = M_PI / 2.0;
+const double Pusher::maxspeedx = 0.5;
+const double Pusher::maxspeeda = M_PI / 2.0;
+
+Pusher::Pusher(World &world,
+               robot_shape_t shape,
+               double size,
+               double x,
+               double y,
+               double a)
+    : Robot(world,
+            x, y, a,
+            shape,
+            size,
+            5,    // drive gain
+            20,   // turn gain
+            0,    // charge start
+            20,   // charge max
+            0.4), // input efficiency
+                  //0.1,
+                  //0), // stay charged forever
+      state(S_PUSH),
+      timeleft(rng.Uniform() * TURNMAX),
+      speedx(0),
+      speeda(0),
+      lastintensity(0),
+      latch(0),
+      count(rng.Uniform() * 1000.0),
+      escape(false),
+      phase(rng.Below(50))
+{
+  // front left, front right, back left, back right
+  sensors.push_back(b2Vec2(+0.1, -0.1));
+  sensors.push_back(b2Vec2(+0.1, +0.1));
+  sensors.push_back(b2Vec2(-0.1, -0.1));
+  sensors.push_back(b2Vec2(-0.1, +0.1));
+}
+
+bool Pusher::SensorsDue() const
+{
+  return world.steps % 50 == phase;
+}
+
+void Pusher::Update(double timestep)
+{
+  if (SensorsDue())
+  {
+    const double fleft = sensed[0];
+    const double fright = sensed[1];
+
+    const double bleft = sensed[2];
+    const double bright = sensed[3];
+
+    speedx = drive_gain * ((fright + fleft) - (bright + bleft));
+    speeda = turn_gain * (fright - fleft);
+
+    SetSpeed(speedx, 0, speeda);
+  }
+
+  Robot::Update(timestep); // inherit underlying behaviour to handle charge/discharge
+}
@@ -1,55 +1,22 @@
 #!/bin/bash
 
-cd
-cd Documents/USRA/push
+# Everything below is relative to the top of the tree, where this lives
+cd "$(dirname "$0")"
 
 BASE="./push -r 200 -b 500 -z 0.5 -s 0.5 -t C -y H -g 50"
 BASESMALL="200Robots500Boxes"
 
 # Produce all square results
-squaresarray=( "square_tight" )
-circleswitcharray=( "0" "1" )
-for i in "${squaresarray[@]}"
-do
-	for l in "${circleswitcharray[@]}"
-	do	
-		QUALIFIER=""
-		if [ $l == "0" ]
-		then
-			QUALIFIER=""
-		fi
-		if [ $l == "1" ]
-		then
-			QUALIFIER="_switch"
-		fi
-		NAME=$i$QUALIFIER
-		cd Results_Replays
-		cd $BASESMALL
-		mkdir $NAME
-		cd ..
-		cd ..
-		cd Results
-		cd $BASESMALL
-		mkdir $NAME
-		cd ..
-		cd ..
-		if [ $i == "square_tight" ]
-		then
-			ADDITIONAL=" -d 0"
-		fi
-		if [ $i == "squareflare_preprime_tight" ]
-		then
-			ADDITIONAL=" -d 0 -f 1.5"
-		fi
-		if [ $i == "squaredrag_tight" ]
-		then
-			ADDITIONAL=" -d 0.25"
-		fi
-		for j in {40..99}
-		do
-			$BASE $ADDITIONAL -c $l -p shapes/square.txt -o $BASESMALL/$NAME/$NAME$j -x
-		done
-	done
-done
+# Every combination of circle switch and seed runs inside one process,
+# several at a time. Run k of the grid is saved as square_tight_k
+mkdir -p Results_Replays/$BASESMALL Results/$BASESMALL
+cat > square_tight.sweep <<EOF
+-c 0 1
+-e 40..99
+EOF
+$BASE -d 0 -p shapes/square.txt -o $BASESMALL/square_tight -q square_tight.sweep -j $(nproc) -x
+
+# Success at every saved frame of every run, in one table
+./replaystats -j $(nproc) Results/$BASESMALL/summary.tsv Results_Replays/$BASESMALL/*.txt
 
 echo "Complete!"
@@ -0,0 +1,578 @@
+#include "push.hh"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <math.h>
+
+// Every record is a 4 character tag, a payload length and the payload.
+// Lengths are padded to 8 bytes, and the first record starts on an 8
+// byte boundary after the text header, so every payload is aligned
+// for the structs above once the file is mapped
+//
+//   INFO  version, robots, boxes, lights, key interval (uint32 each)
+//   QINF  width, height, maximum charge (float), tolerance (uint32).
+//         Only in quantised replays, where it comes before any frame
+//   GOAL  ReplayGoal[]
+//   FRAM  step (uint64), flags, light count (uint32), ReplayRobot[],
+//         ReplayBox[], ReplayLight[]
+//   FRMQ  step (uint64), flags, light count, robot count, box count
+//         (uint32 each), QuantRobot[], QuantBox[], ReplayLight[].
+//         Keyframes hold every body, other frames only the ones that
+//         moved
+//   SUCC  success (double)
+//   INDX  offset of every FRAM record (uint64[])
+//   TAIL  offset of INDX, offset of SUCC or 0 (uint64 each). Always last
+
+static const uint32_t VERSION = 1;
+
+// Flags for FRAM and FRMQ records
+static const uint32_t FRAME_KEY = 0x1; // Every lit light (and body), not changes
+
+static uint16_t QuantiseUnit(double v)
+{
+  return lround(std::min(1.0, std::max(0.0, v)) * 65535);
+}
+
+static double UnitOf(uint16_t q)
+{
+  return q / 65535.0;
+}
+
+static uint16_t QuantiseAngle(double a)
+{
+  // remainder leaves a in [-pi, pi]; 65536 wraps back to 0
+  return (uint16_t)(lround((remainder(a, 2 * M_PI) + M_PI) / (2 * M_PI) * 65536) & 0xffff);
+}
+
+static double AngleOf(uint16_t q)
+{
+  return q * (2 * M_PI / 65536) - M_PI;
+}
+
+// Whether two quantised values differ by more than @tolerance steps
+static bool Moved(uint16_t a, uint16_t b, uint32_t tolerance)
+{
+  return (uint32_t)abs((int)a - (int)b) > tolerance;
+}
+
+static bool Turned(uint16_t a, uint16_t b, uint32_t tolerance)
+{
+  return (uint32_t)abs((int16_t)(a - b)) > tolerance;
+}
+
+static uint32_t Tag(const char *name)
+{
+  uint32_t tag;
+  memcpy(&tag, name, 4);
+  return tag;
+}
+
+static size_t Pad(size_t bytes)
+{
+  return (bytes + 7) & ~(size_t)7;
+}
+
+// True if the record at @offset, with all the bytes its head claims, lies
+// inside the @size bytes at @data
+static bool RecordFits(const char *data, size_t size, uint64_t offset)
+{
+  if (offset > size || size - offset < 8)
+    return false;
+  uint32_t head[2];
+  memcpy(head, data + offset, sizeof(head));
+  return head[1] <= size - offset - 8;
+}
+
+ReplayWriter::ReplayWriter(const std::string &fileName, size_t robots, size_t boxes, size_t lights, size_t keyInterval) : file(new BufferedFile(fileName, false, false)),
+                                                                                                                        ownsFile(true),
+                                                                                                                        robotCount(robots),
+                                                                                                                        boxCount(boxes),
+                                                                                                                        lightCount(lights),
+                                                                                                                        keyInterval(keyInterval),
+                                                                                                                        successOffset(0),
+                                                                                                                        quantised(false)
+{
+  Begin();
+}
+
+ReplayWriter::ReplayWriter(BufferedFile &file, size_t robots, size_t boxes, size_t lights, size_t keyInterval) : file(&file),
+                                                                                                                ownsFile(false),
+                                                                                                                robotCount(robots),
+                                                                                                                boxCount(boxes),
+                                                                                                                lightCount(lights),
+                                                                                                                keyInterval(keyInterval),
+                                                                                                                successOffset(0),
+                                                                                                                quantised(false)
+{
+  Begin();
+}
+
+void ReplayWriter::Begin()
+{
+  if (!IsOpen())
+    return;
+
+  // Align the first record
+  static const char zeros[8] = {0};
+  file->Write(zeros, Pad(file->Offset()) - file->Offset());
+
+  const uint32_t info[5] = {VERSION, (uint32_t)robotCount, (uint32_t)boxCount, (uint32_t)lightCount, (uint32_t)keyInterval};
+  WriteRecord(Tag("INFO"), {{info, sizeof(info)}});
+}
+
+ReplayWriter::~ReplayWriter()
+{
+  Close();
+}
+
+void ReplayWriter::WriteRecord(uint32_t tag, const std::vector<std::pair<const void *, size_t>> &parts)
+{
+  size_t length = 0;
+  for (auto &part : parts)
+    length += part.second;
+  const uint32_t head[2] = {tag, (uint32_t)Pad(length)};
+  file->Write(head, sizeof(head));
+  for (auto &part : parts)
+    file->Write(part.first, part.second);
+  static const char zeros[8] = {0};
+  file->Write(zeros, Pad(length) - length);
+}
+
+void ReplayWriter::Quantise(float width, float height, float chargeMax, uint32_t tolerance)
+{
+  if (!IsOpen() || !frameOffsets.empty())
+    return;
+  quantised = true;
+  qWidth = width;
+  qHeight = height;
+  qChargeMax = chargeMax;
+  qTolerance = tolerance;
+  const float scales[3] = {width, height, chargeMax};
+  WriteRecord(Tag("QINF"), {{scales, sizeof(scales)}, {&tolerance, sizeof(tolerance)}});
+}
+
+void ReplayWriter::AppendGoals(const std::vector<ReplayGoal> &goals)
+{
+  if (!IsOpen())
+    return;
+  WriteRecord(Tag("GOAL"), {{goals.data(), goals.size() * sizeof(ReplayGoal)}});
+}
+
+bool ReplayWriter::KeyFrameDue(size_t lights) const
+{
+  return frameOffsets.size() % keyInterval == 0 || lastIntensities.size() != lights;
+}
+
+// Records @index if it differs from the last frame written
+void ReplayWriter::AppendLight(uint32_t index, float intensity)
+{
+  if (intensity != lastIntensities[index])
+  {
+    lightRecords.push_back({index, intensity});
+    lastIntensities[index] = intensity;
+  }
+}
+
+void ReplayWriter::AppendFrame(uint64_t step, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes, const std::vector<float> &intensities)
+{
+  if (!IsOpen())
+    return;
+
+  uint32_t flags = 0;
+  lightRecords.clear();
+  if (KeyFrameDue(intensities.size()))
+  {
+    flags |= FRAME_KEY;
+    for (size_t i = 0; i < intensities.size(); ++i)
+      if (intensities[i] != 0)
+        lightRecords.push_back({(uint32_t)i, intensities[i]});
+  }
+  else
+  {
+    for (size_t i = 0; i < intensities.size(); ++i)
+      if (intensities[i] != lastIntensities[i])
+        lightRecords.push_back({(uint32_t)i, intensities[i]});
+  }
+  lastIntensities = intensities;
+
+  AppendRecords(step, flags, robots, boxes);
+}
+
+void ReplayWriter::AppendFrame(uint64_t step, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes, const std::vector<double> &intensities, const LightChanges &changes)
+{
+  if (!IsOpen())
+    return;
+
+  uint32_t flags = 0;
+  lightRecords.clear();
+  if (KeyFrameDue(intensities.size()))
+  {
+    flags |= FRAME_KEY;
+    lastIntensities.assign(intensities.begin(), intensities.end());
+    for (size_t i = 0; i < lastIntensities.size(); ++i)
+      if (lastIntensities[i] != 0)
+        lightRecords.push_back({(uint32_t)i, lastIntensities[i]});
+  }
+  else if (changes.all)
+  {
+    for (size_t i = 0; i < intensities.size(); ++i)
+      AppendLight(i, intensities[i]);
+  }
+  else
+  {
+    // In index order, as a full comparison would find them
+    changedLights = changes.indices;
+    std::sort(changedLights.begin(), changedLights.end());
+    for (auto i : changedLights)
+      AppendLight(i, intensities[i]);
+  }
+
+  AppendRecords(step, flags, robots, boxes);
+}
+
+void ReplayWriter::AppendRecords(uint64_t step, uint32_t flags, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes)
+{
+  if (quantised)
+  {
+    AppendQuantisedFrame(step, flags, robots, boxes);
+    return;
+  }
+
+  frameOffsets.push_back(file->Offset());
+  const uint32_t head[2] = {flags, (uint32_t)lightRecords.size()};
+  WriteRecord(Tag("FRAM"), {{&step, sizeof(step)},
+                            {head, sizeof(head)},
+                            {robots.data(), robotCount * sizeof(ReplayRobot)},
+                            {boxes.data(), boxCount * sizeof(ReplayBox)},
+                            {lightRecords.data(), lightRecords.size() * sizeof(ReplayLight)}});
+}
+
+void ReplayWriter::AppendQuantisedFrame(uint64_t step, uint32_t flags, const std::vector<ReplayRobot> &robots, const std::vector<ReplayBox> &boxes)
+{
+  const bool key = flags & FRAME_KEY;
+  lastRobots.resize(robotCount);
+  lastBoxes.resize(boxCount);
+
+  // Compare against what was last written, not the last frame, so slow
+  // drift still gets recorded once it adds up
+  std::vector<QuantRobot> robotRecords;
+  for (uint32_t i = 0; i < robotCount; ++i)
+  {
+    const QuantRobot q = {i, QuantiseUnit(robots[i].x / qWidth), QuantiseUnit(robots[i].y / qHeight),
+                          QuantiseAngle(robots[i].a), QuantiseUnit(robots[i].charge / qChargeMax)};
+    QuantRobot &last = lastRobots[i];
+    if (key || Moved(q.x, last.x, qTolerance) || Moved(q.y, last.y, qTolerance) ||
+        Turned(q.a, last.a, qTolerance) || Moved(q.charge, last.charge, qTolerance))
+    {
+      robotRecords.push_back(q);
+      last = q;
+    }
+  }
+
+  std::vector<QuantBox> boxRecords;
+  for (uint32_t i = 0; i < boxCount; ++i)
+  {
+    const QuantBox q = {i, QuantiseUnit(boxes[i].x / qWidth), QuantiseUnit(boxes[i].y / qHeight),
+                        QuantiseAngle(boxes[i].a), (uint16_t)(boxes[i].insidePoly != 0)};
+    QuantBox &last = lastBoxes[i];
+    if (key || Moved(q.x, last.x, qTolerance) || Moved(q.y, last.y, qTolerance) ||
+        Turned(q.a, last.a, qTolerance) || q.insidePoly != last.insidePoly)
+    {
+      boxRecords.push_back(q);
+      last = q;
+    }
+  }
+
+  frameOffsets.push_back(file->Offset());
+  const uint32_t head[4] = {flags, (uint32_t)lightRecords.size(), (uint32_t)robotRecords.size(), (uint32_t)boxRecords.size()};
+  WriteRecord(Tag("FRMQ"), {{&step, sizeof(step)},
+                            {head, sizeof(head)},
+                            {robotRecords.data(), robotRecords.size() * sizeof(QuantRobot)},
+                            {boxRecords.data(), boxRecords.size() * sizeof(QuantBox)},
+                            {lightRecords.data(), lightRecords.size() * sizeof(ReplayLight)}});
+}
+
+void ReplayWriter::AppendSuccess(double success)
+{
+  if (!IsOpen())
+    return;
+  successOffset = file->Offset();
+  WriteRecord(Tag("SUCC"), {{&success, sizeof(success)}});
+}
+
+void ReplayWriter::Close()
+{
+  if (!file)
+    return;
+  if (file->IsOpen())
+  {
+    const uint64_t indexOffset = file->Offset();
+    WriteRecord(Tag("INDX"), {{frameOffsets.data(), frameOffsets.size() * sizeof(uint64_t)}});
+    const uint64_t tail[2] = {indexOffset, successOffset};
+    WriteRecord(Tag("TAIL"), {{tail, sizeof(tail)}});
+  }
+  if (ownsFile)
+    delete file;
+  else
+    file->Flush();
+  file = NULL;
+}
+
+bool ReplayReader::IsBinary(const std::string &fileName)
+{
+  // The text header is shared, so look for the first record
+  FILE *file = fopen(fileName.c_str(), "rb");
+  if (!file)
+    return false;
+  char buffer[4096];
+  const size_t got = fread(buffer, 1, sizeof(buffer), file);
+  fclose(file);
+  const char *end = (const char *)memmem(buffer, got, "\n$\n", 3);
+  if (!end)
+    return false;
+  const size_t start = Pad(end + 3 - buffer);
+  return start + 4 <= got && memcmp(buffer + start, "INFO", 4) == 0;
+}
+
+ReplayReader::ReplayReader(const std::string &fileName) : data(NULL),
+                                                          size(0),
+                                                          robotCount(0),
+                                                          boxCount(0),
+                                                          lightCount(0),
+                                                          keyInterval(1),
+                                                          quantised(false),
+                                                          successRecord(NULL),
+                                                          stateFrame(-1)
+{
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED)
+    {
+      data = (const char *)mapped;
+      size = st.st_size;
+    }
+  }
+  close(fd);
+  if (!data)
+    return;
+
+  const char *end = (const char *)memmem(data, std::min(size, (size_t)4096), "\n$\n", 3);
+  size_t pos = end ? Pad(end + 3 - data) : size;
+  if (pos + 8 + 5 * sizeof(uint32_t) > size || memcmp(data + pos, "INFO", 4) != 0)
+  {
+    munmap((void *)data, size);
+    data = NULL;
+    return;
+  }
+
+  uint32_t info[5];
+  memcpy(info, data + pos + 8, sizeof(info));
+  robotCount = info[1];
+  boxCount = info[2];
+  lightCount = info[3];
+  keyInterval = std::max(1u, info[4]);
+  robots.resize(robotCount);
+  boxes.resize(boxCount);
+  intensities.assign(lightCount, 0.0f);
+
+  // The records before the first frame describe the whole replay
+  while (pos + 8 <= size)
+  {
+    uint32_t head[2];
+    memcpy(head, data + pos, sizeof(head));
+    if (head[0] == Tag("FRAM") || head[0] == Tag("FRMQ") || pos + 8 + head[1] > size)
+      break;
+    if (head[0] == Tag("QINF"))
+    {
+      memcpy(scales, data + pos + 8, sizeof(scales));
+      quantised = true;
+    }
+    else if (head[0] == Tag("GOAL"))
+    {
+      const ReplayGoal *g = (const ReplayGoal *)(data + pos + 8);
+      goals.assign(g, g + head[1] / sizeof(ReplayGoal));
+    }
+    pos += 8 + head[1];
+  }
+
+  // A finished file ends with TAIL, which leads straight to the index. The
+  // index is only used if everything it points at lies inside the file
+  uint64_t tail[2];
+  if (size >= pos + 24 && memcmp(data + size - 24, "TAIL", 4) == 0)
+  {
+    memcpy(tail, data + size - 16, sizeof(tail));
+    bool indexed = RecordFits(data, size, tail[0]) && memcmp(data + tail[0], "INDX", 4) == 0;
+    uint32_t length = 0;
+    if (indexed)
+      memcpy(&length, data + tail[0] + 4, sizeof(length));
+    for (size_t i = 0; indexed && i < length / sizeof(uint64_t); ++i)
+    {
+      uint64_t offset;
+      memcpy(&offset, data + tail[0] + 8 + i * sizeof(offset), sizeof(offset));
+      indexed = RecordFits(data, size, offset);
+      frames.push_back(data + offset);
+    }
+    if (indexed && tail[1])
+    {
+      indexed = RecordFits(data, size, tail[1]);
+      successRecord = data + tail[1];
+    }
+    if (indexed)
+      return;
+    frames.clear();
+    successRecord = NULL;
+  }
+
+  // Otherwise walk the records, stopping at anything cut short
+  while (pos + 8 <= size)
+  {
+    uint32_t head[2];
+    memcpy(head, data + pos, sizeof(head));
+    if (pos + 8 + head[1] > size)
+      break;
+    if (head[0] == Tag("FRAM") || head[0] == Tag("FRMQ"))
+      frames.push_back(data + pos);
+    else if (head[0] == Tag("SUCC"))
+      successRecord = data + pos;
+    pos += 8 + head[1];
+  }
+}
+
+ReplayReader::~ReplayReader()
+{
+  if (data)
+    munmap((void *)data, size);
+}
+
+uint64_t ReplayReader::Step(size_t frame) const
+{
+  uint32_t length;
+  memcpy(&length, frames[frame] + 4, sizeof(length));
+  uint64_t step = 0;
+  if (length >= sizeof(step))
+    memcpy(&step, frames[frame] + 8, sizeof(step));
+  return step;
+}
+
+const ReplayRobot *ReplayReader::Robots(size_t frame)
+{
+  Seek(frame);
+  return robots.data();
+}
+
+const ReplayBox *ReplayReader::Boxes(size_t frame)
+{
+  Seek(frame);
+  return boxes.data();
+}
+
+const std::vector<float> &ReplayReader::Lights(size_t frame)
+{
+  Seek(frame);
+  return intensities;
+}
+
+void ReplayReader::ApplyFrame(size_t frame)
+{
+  const char *record = frames[frame];
+  const ReplayLight *l;
+  uint32_t length;
+  memcpy(&length, record + 4, sizeof(length));
+
+  // The step, flags and light count, then the robot and box counts if
+  // quantised. A frame whose counts run past its record changes nothing
+  const uint32_t headBytes = quantised ? 24 : 16;
+  uint32_t head[4] = {0, 0, 0, 0};
+  if (length < headBytes)
+  {
+    stateFrame = frame;
+    return;
+  }
+  memcpy(head, record + 16, headBytes - 8);
+  uint64_t bytes = headBytes + (uint64_t)head[1] * sizeof(ReplayLight);
+  if (quantised)
+    bytes += (uint64_t)head[2] * sizeof(QuantRobot) + (uint64_t)head[3] * sizeof(QuantBox);
+  else
+    bytes += robotCount * sizeof(ReplayRobot) + boxCount * sizeof(ReplayBox);
+  if (bytes > length)
+  {
+    stateFrame = frame;
+    return;
+  }
+
+  if (!quantised)
+  {
+    const char *body = record + 24;
+    memcpy(robots.data(), body, robotCount * sizeof(ReplayRobot));
+    body += robotCount * sizeof(ReplayRobot);
+    memcpy(boxes.data(), body, boxCount * sizeof(ReplayBox));
+    l = (const ReplayLight *)(body + boxCount * sizeof(ReplayBox));
+  }
+  else
+  {
+    const QuantRobot *qr = (const QuantRobot *)(record + 32);
+    for (uint32_t i = 0; i < head[2]; ++i)
+      if (qr[i].index < robotCount)
+      {
+        ReplayRobot &r = robots[qr[i].index];
+        r.x = UnitOf(qr[i].x) * scales[0];
+        r.y = UnitOf(qr[i].y) * scales[1];
+        r.a = AngleOf(qr[i].a);
+        r.charge = UnitOf(qr[i].charge) * scales[2];
+      }
+    const QuantBox *qb = (const QuantBox *)(qr + head[2]);
+    for (uint32_t i = 0; i < head[3]; ++i)
+      if (qb[i].index < boxCount)
+      {
+        ReplayBox &b = boxes[qb[i].index];
+        b.x = UnitOf(qb[i].x) * scales[0];
+        b.y = UnitOf(qb[i].y) * scales[1];
+        b.a = AngleOf(qb[i].a);
+        b.insidePoly = qb[i].insidePoly;
+      }
+    l = (const ReplayLight *)(qb + head[3]);
+  }
+
+  if (head[0] & FRAME_KEY)
+    std::fill(intensities.begin(), intensities.end(), 0.0f);
+  for (uint32_t i = 0; i < head[1]; ++i)
+    if (l[i].index < intensities.size())
+      intensities[l[i].index] = l[i].intensity;
+  stateFrame = frame;
+}
+
+void ReplayReader::Seek(size_t frame)
+{
+  if (stateFrame >= 0 && frame == (size_t)stateFrame)
+    return;
+  if (stateFrame >= 0 && frame == (size_t)stateFrame + 1)
+  {
+    ApplyFrame(frame);
+    return;
+  }
+
+  // The writer makes every keyInterval-th frame a keyframe
+  for (size_t f = frame - frame % keyInterval; f <= frame; ++f)
+    ApplyFrame(f);
+}
+
+bool ReplayReader::GetSuccess(double &success) const
+{
+  if (!successRecord)
+    return false;
+  uint32_t length;
+  memcpy(&length, successRecord + 4, sizeof(length));
+  if (length < sizeof(success))
+    return false;
+  memcpy(&success, successRecord + 8, sizeof(success));
+  return true;
+}
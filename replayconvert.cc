@@ -0,0 +1,116 @@
+// Converts a text replay into a binary one
+// Usage: replayconvert Results_Replays/in.txt Results_Replays/out.bin [Q]
+// Q stores quantised poses, and only for the bodies that moved.
+// The results file is looked up by name, so keep the same base name
+
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "push.hh"
+
+int main(int argc, char *argv[])
+{
+  if (argc != 3 && !(argc == 4 && (argv[3][0] == 'Q' || argv[3][0] == 'q')))
+  {
+    fprintf(stderr, "Usage: %s <text replay> <binary replay> [Q]\n", argv[0]);
+    return 1;
+  }
+  const bool quantise = (argc == 4);
+
+  std::ifstream in(argv[1]);
+  std::string headerStr, optionStr, lineStr;
+  getline(in, headerStr);
+  getline(in, optionStr);
+  getline(in, lineStr);
+  if (headerStr != "HEADER:" || lineStr != "$")
+  {
+    fprintf(stderr, "%s is not a text replay\n", argv[1]);
+    return 1;
+  }
+
+  double width = 64, height = 64;
+  size_t robots = 0, boxes = 0;
+  std::stringstream ss(optionStr);
+  std::string option, value;
+  while (ss >> option >> value)
+  {
+    if (option == "-w")
+      width = atof(value.c_str());
+    else if (option == "-h")
+      height = atof(value.c_str());
+    else if (option == "-r")
+      robots = atoi(value.c_str());
+    else if (option == "-b")
+      boxes = atoi(value.c_str());
+  }
+  const size_t lights = width * height;
+
+  {
+    std::ofstream out(argv[2]);
+    out << "HEADER:\n" << optionStr << (quantise ? " -k Q\n" : " -k B\n") << "$\n";
+  }
+  ReplayWriter writer(argv[2], robots, boxes, lights);
+  if (!writer.IsOpen())
+    return 1;
+
+  // Text replays don't record the capacity; this is what main gives a Pusher
+  if (quantise)
+    writer.Quantise(width, height, 20, 1);
+
+  std::vector<ReplayGoal> goals;
+  std::vector<ReplayRobot> robotRecords(robots);
+  std::vector<ReplayBox> boxRecords(boxes);
+  std::vector<float> intensities(lights, 0.0f);
+  bool wroteGoals = false;
+  bool haveSuccess = false;
+  double success = 0;
+  uint64_t frames = 0;
+
+  // The header comes back as a state with no sections
+  TextReplayReader replay(argv[1]);
+  while (replay.NextState())
+  {
+    if (replay.hasGoals)
+      goals.insert(goals.end(), replay.goals.begin(), replay.goals.end());
+    for (size_t i = 0; replay.hasRobots && i < replay.robots.size() && i < robots; ++i)
+      robotRecords[i] = replay.robots[i];
+    for (size_t i = 0; replay.hasBoxes && i < replay.boxes.size() && i < boxes; ++i)
+      boxRecords[i] = replay.boxes[i];
+    if (replay.hasLights)
+    {
+      // Lights that aren't listed are off
+      std::fill(intensities.begin(), intensities.end(), 0.0f);
+      for (auto &l : replay.lights)
+        if (l.index < lights)
+          intensities[l.index] = l.intensity;
+    }
+    if (replay.hasSuccess)
+    {
+      success = replay.success;
+      haveSuccess = true;
+    }
+
+    if (replay.hasRobots || replay.hasBoxes)
+    {
+      if (!wroteGoals)
+      {
+        writer.AppendGoals(goals);
+        wroteGoals = true;
+      }
+      writer.AppendFrame(frames++, robotRecords, boxRecords, intensities);
+    }
+  }
+
+  if (!wroteGoals)
+    writer.AppendGoals(goals);
+  if (haveSuccess)
+    writer.AppendSuccess(success);
+  writer.Close();
+
+  printf("Converted %lu frames\n", (unsigned long)frames);
+  return 0;
+}
@@ -0,0 +1,192 @@
+// Recomputes the success measures of saved replays without running them
+// Usage: replaystats [-j threads] <table> <replay> [replay...]
+// Every frame of every replay gets a row in the table, with the same
+// numbers evaluateSuccessInsidePoly writes to the performance file. No
+// Box2D world is made; box positions come straight from the replay and
+// the goal polygon from the run's performance file
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "push.hh"
+
+struct ReplayOptions
+{
+  double width, height, boxSize;
+  char boxShape;
+  ReplayOptions() : width(64), height(64), boxSize(0.25), boxShape('R') {}
+};
+
+static bool ReadOptions(const std::string &fileName, ReplayOptions &options)
+{
+  std::ifstream file(fileName);
+  std::string headerStr, optionStr;
+  getline(file, headerStr);
+  getline(file, optionStr);
+  if (headerStr != "HEADER:")
+    return false;
+
+  std::stringstream ss(optionStr);
+  std::string option, value;
+  while (ss >> option >> value)
+  {
+    if (option == "-w")
+      options.width = atof(value.c_str());
+    else if (option == "-h")
+      options.height = atof(value.c_str());
+    else if (option == "-s")
+      options.boxSize = atof(value.c_str());
+    else if (option == "-y")
+      options.boxShape = toupper(value[0]);
+  }
+  return true;
+}
+
+// Results_Replays/<name>.txt keeps its goal shape in Results/<name>_PerfData.txt.
+// Works the same way as World::loadGoalPolygon; false means a circle
+static bool ReadGoalPolygon(const std::string &fileName, Polygon &polygon)
+{
+  std::string name = fileName.substr(0, fileName.rfind('.'));
+  const size_t dir = name.find("Results_Replays");
+  if (dir != std::string::npos)
+    name.replace(dir, 15, "Results");
+  std::ifstream file(name + "_PerfData.txt");
+
+  std::string lineStr;
+  while (getline(file, lineStr))
+  {
+    if (lineStr.compare(0, 13, "TargetShape: ") != 0)
+      continue;
+    lineStr.erase(0, 13);
+    lineStr.erase(std::remove(lineStr.begin(), lineStr.end(), ','), lineStr.end());
+    if (lineStr == "Circle")
+      return false;
+
+    std::stringstream ss(lineStr);
+    double x, y;
+    while (ss >> x >> y)
+      polygon.vertices.push_back(Vertex(x, y));
+    return !polygon.vertices.empty();
+  }
+  return false;
+}
+
+// One frame's row, measured the way evaluateSuccessInsidePoly does
+static void Measure(const std::string &fileName, size_t frame, const ReplayBox *boxes, size_t count,
+                    Polygon *polygon, double cx, double cy, double minRad, std::ostringstream &out)
+{
+  double numCorrect = 0, numIncorrect = 0, outsideDist = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    double dist;
+    if (polygon)
+      dist = polygon->pointInsidePoly(boxes[i].x, boxes[i].y) ? 0 : polygon->getDistFromPoint(boxes[i].x, boxes[i].y);
+    else
+      dist = std::max(0.0, sqrt((cx - boxes[i].x) * (cx - boxes[i].x) + (cy - boxes[i].y) * (cy - boxes[i].y)) - minRad);
+    if (dist <= 0)
+      ++numCorrect;
+    else
+    {
+      ++numIncorrect;
+      outsideDist += dist;
+    }
+  }
+  out << fileName << "\t" << frame << "\t" << numCorrect << "\t" << count << "\t"
+      << numCorrect / count << "\t" << outsideDist / count << "\t" << outsideDist / numIncorrect << "\n";
+}
+
+static void Analyse(const std::string &fileName, std::ostringstream &out)
+{
+  ReplayOptions options;
+  if (!ReadOptions(fileName, options))
+  {
+    fprintf(stderr, "%s is not a replay\n", fileName.c_str());
+    return;
+  }
+
+  Polygon goal;
+  const bool havePolygon = ReadGoalPolygon(fileName, goal);
+
+  // The circle's centre and radius, as main and evaluateSuccessInsidePoly
+  // work them out. There is one light per square unit
+  const double ldx = sqrt(options.width * options.height) / options.width / 2.0;
+  const double ldy = sqrt(options.width * options.height) / options.height / 2.0;
+  const double cx = options.width / 2.0 + ldx;
+  const double cy = options.height / 2.0 + ldy;
+  double boxArea;
+  if (options.boxShape == 'R')
+    boxArea = options.boxSize * options.boxSize;
+  else if (options.boxShape == 'C')
+    boxArea = M_PI * ((options.boxSize / 2) * (options.boxSize / 2));
+  else
+  {
+    double apothem = sqrt((options.boxSize / 2) * (options.boxSize / 2) - (options.boxSize / 4) * (options.boxSize / 4));
+    boxArea = (apothem * (options.boxSize / 4.0)) * 6.0;
+  }
+
+  if (ReplayReader::IsBinary(fileName))
+  {
+    ReplayReader replay(fileName);
+    const double minRad = sqrt(replay.BoxCount() * boxArea / M_PI);
+    for (size_t frame = 0; frame < replay.Frames() && replay.BoxCount(); ++frame)
+      Measure(fileName, frame, replay.Boxes(frame), replay.BoxCount(), havePolygon ? &goal : NULL, cx, cy, minRad, out);
+    return;
+  }
+
+  TextReplayReader replay(fileName);
+  size_t frame = 0;
+  while (replay.NextState())
+  {
+    if (!replay.hasBoxes || replay.boxes.empty())
+      continue;
+    const double minRad = sqrt(replay.boxes.size() * boxArea / M_PI);
+    Measure(fileName, frame++, &replay.boxes[0], replay.boxes.size(), havePolygon ? &goal : NULL, cx, cy, minRad, out);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int threads = 1;
+  int ch;
+  while ((ch = getopt(argc, argv, "j:")) != -1)
+  {
+    if (ch == 'j')
+      threads = std::max(1, atoi(optarg));
+    else
+      return 1;
+  }
+  if (argc - optind < 2)
+  {
+    fprintf(stderr, "Usage: %s [-j threads] <table> <replay> [replay...]\n", argv[0]);
+    return 1;
+  }
+
+  const std::string tableName = argv[optind];
+  std::vector<std::string> files(argv + optind + 1, argv + argc);
+  std::vector<std::ostringstream> results(files.size());
+
+  // Replays differ a lot in length, so each thread takes the next file
+  // as it finishes one rather than a fixed share
+  WorkerPool pool(threads - 1);
+  std::atomic<size_t> next(0);
+  pool.Run(pool.Size(), [&](size_t, size_t) {
+    for (size_t i = next++; i < files.size(); i = next++)
+      Analyse(files[i], results[i]);
+  });
+
+  std::ofstream table(tableName);
+  table << "Replay\tFrame\tInsideGoal\tBoxes\tPercentage\tTotalAverageDistance\tOutsideAverageDistance\n";
+  for (auto &r : results)
+    table << r.str();
+
+  printf("Analysed %lu replays\n", (unsigned long)files.size());
+  return 0;
+}
@@ -0,0 +1,41 @@
+#include "push.hh"
+
+// Draw n of a stream is a pure function of (seed, stream, n): the
+// SplitMix64 finaliser applied to a Weyl sequence keyed by the stream.
+// Streams never share state, so each robot can draw from its own on
+// any thread and still get the same numbers for the same seed
+
+static uint64_t mix(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+Rng::Rng(uint64_t seed, uint64_t stream) : counter(0)
+{
+  Seed(seed, stream);
+}
+
+void Rng::Seed(uint64_t seed, uint64_t stream)
+{
+  // Hash the pair so neighbouring streams start far apart
+  key = mix(mix(seed) ^ (stream * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL));
+  counter = 0;
+}
+
+uint64_t Rng::Next()
+{
+  return mix(key + ++counter * 0x9e3779b97f4a7c15ULL);
+}
+
+double Rng::Uniform()
+{
+  // The top 53 bits fill a double's mantissa exactly
+  return (Next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+size_t Rng::Below(size_t n)
+{
+  return Next() % n;
+}
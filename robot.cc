@@ -33,7 +33,11 @@ Robot::Robot(World &world,
                                          input_efficiency(input_efficiency),
                                          output_metabolic(output_metabolic),
                                          output_efficiency(output_efficiency),
-                                         body(NULL)
+                                         light(0),
+                                         rng(world.seed, Rng::STREAM_ROBOT + world.robots.size()),
+                                         body(NULL),
+                                         speedPending(false),
+                                         pendingWake(false)
 //bumper( NULL ),
 //joint( NULL )
 {
@@ -221,8 +225,33 @@ double Robot::GetLightIntensityAt(double x, double y) const
 // set body speed in body-local coordinate frame
 void Robot::SetSpeed(double x, double y, double a)
 {
-  body->SetLinearVelocity(body->GetWorldVector(b2Vec2(x, y)));
-  body->SetAngularVelocity(a);
+  pendingLinear = body->GetWorldVector(b2Vec2(x, y));
+  pendingAngular = a;
+  speedPending = true;
+  if (b2Dot(pendingLinear, pendingLinear) > 0 || pendingAngular * pendingAngular > 0)
+    pendingWake = true;
+}
+
+void Robot::ApplySpeed()
+{
+  if (!speedPending)
+    return;
+  if (pendingWake)
+    body->SetAwake(true);
+  body->SetLinearVelocity(pendingLinear);
+  body->SetAngularVelocity(pendingAngular);
+  speedPending = false;
+  pendingWake = false;
+}
+
+b2Vec2 Robot::GetLinearVelocity() const
+{
+  return speedPending ? pendingLinear : body->GetLinearVelocity();
+}
+
+float32 Robot::GetAngularVelocity() const
+{
+  return speedPending ? pendingAngular : body->GetAngularVelocity();
 }
 
 void Robot::Update(double timestep)
@@ -230,14 +259,14 @@ void Robot::Update(double timestep)
   //UpdateTargetSensor();
 
   // absorb energy from lights
-  charge_delta = input_efficiency * GetLightIntensity(); // gather power from light
+  charge_delta = input_efficiency * light; // gather power from light, as read by World::SenseLights
 
   // expend energy just living
   charge_delta -= output_metabolic;
 
   // expend energy by moving
-  charge_delta -= output_efficiency * body->GetAngularVelocity();
-  charge_delta -= output_efficiency * body->GetLinearVelocity().Length();
+  charge_delta -= output_efficiency * GetAngularVelocity();
+  charge_delta -= output_efficiency * GetLinearVelocity().Length();
 
   charge += charge_delta;
 
@@ -0,0 +1,67 @@
+#include "push.hh"
+#include <math.h>
+
+static void Wake(Box *box)
+{
+  box->settled = false;
+  box->stillTime = 0;
+  box->body->SetType(b2_dynamicBody);
+  box->body->SetAwake(true);
+}
+
+void BoxSettler::Update(std::vector<Box *> &boxes, double timestep)
+{
+  // A box can be hit by more than one robot
+  for (auto &box : hit)
+    if (box->settled)
+      Wake(box);
+  hit.clear();
+
+  for (auto &box : boxes)
+  {
+    // insidePoly is as of the last success evaluation, so a box can
+    // settle just after leaving the goal. The next evaluation frees it
+    if (box->settled)
+    {
+      if (!box->insidePoly)
+        Wake(box);
+      continue;
+    }
+
+    const b2Body *body = box->body;
+    if (!box->insidePoly ||
+        body->GetLinearVelocity().LengthSquared() > b2_linearSleepTolerance * b2_linearSleepTolerance ||
+        fabs(body->GetAngularVelocity()) > b2_angularSleepTolerance)
+    {
+      box->stillTime = 0;
+      continue;
+    }
+
+    box->stillTime += timestep;
+    if (box->stillTime >= b2_timeToSleep)
+    {
+      box->settled = true;
+      box->body->SetType(b2_staticBody);
+    }
+  }
+}
+
+void BoxSettler::PostSolve(b2Contact *contact, const b2ContactImpulse *impulse)
+{
+  b2Fixture *boxFixture = contact->GetFixtureA();
+  b2Fixture *robotFixture = contact->GetFixtureB();
+  if (boxFixture->GetBody()->GetType() != b2_staticBody)
+    std::swap(boxFixture, robotFixture);
+
+  // Walls are static too, but have no Box
+  Box *box = (Box *)boxFixture->GetBody()->GetUserData();
+  if (!box || !box->settled || robotFixture->GetFilterData().categoryBits != ROBOT)
+    return;
+
+  for (int32 i = 0; i < impulse->count; ++i)
+    if (impulse->normalImpulses[i] > wakeImpulse)
+    {
+      hit.push_back(box);
+      return;
+    }
+}
@@ -0,0 +1,379 @@
+#include "push.hh"
+#include <stdio.h>
+#include <math.h>
+#include <fstream>
+
+RunConfig::RunConfig() : width(64),
+                         height(64),
+                         robots(128),
+                         boxes(512),
+                         robotSize(0.35),
+                         boxSize(0.25),
+                         robotType(Robot::SHAPE_RECT),
+                         boxType(Box::SHAPE_RECT),
+                         flare(-1.0),
+                         drag(0),
+                         switchToCircle(false),
+                         timeStep(1.0 / 30.0),
+                         maxSteps(100000L),
+                         guiTime(1),
+                         lightFieldSubdivisions(0), // 0 = exact light integration
+                         threads(1),
+                         seed(0),
+                         haveSeed(false), // Otherwise the world seeds itself from the clock
+                         replayFormat('T'),
+                         backgroundOutput(false),
+                         wideContacts(false),
+                         settleImpulse(0),
+                         profileInterval(0),
+                         verbose(true)
+{
+}
+
+Simulation::Simulation(World *world, const RunConfig &config) : world(world),
+                                                                config(config),
+                                                                goalx(0),
+                                                                goaly(0),
+                                                                radius(0),
+                                                                radMin(0),
+                                                                radMax(0),
+                                                                circleRadMax(0),
+                                                                pattWidth(0),
+                                                                delta(0.6),
+                                                                sdelta(0.975), // 'scale' delta. Multiplicative delta, not additive
+                                                                holdAtMin(true),
+                                                                holdTime(1),
+                                                                holdFor(0),
+                                                                goalRadCircle(0)
+{
+}
+
+bool Simulation::Populate()
+{
+  const double WIDTH = config.width;
+  const double HEIGHT = config.height;
+  const size_t LIGHTS = world->numLights;
+
+  if (config.haveSeed)
+    world->SetSeed(config.seed);
+  world->replayFormat = config.replayFormat;
+  world->backgroundOutput = config.backgroundOutput;
+
+  // Create objects
+  // Zoomed In
+  // for (int i = 0; i < BOXES; i++)
+  //   world->AddBox(new Box(*world, box_type, box_size,
+  //                        WIDTH / 4.0 + drand48() * WIDTH * 0.5,
+  //                        HEIGHT / 4.0 + drand48() * HEIGHT * 0.5,
+  //                        drand48() * M_PI));
+
+  // Zoomed Out
+  double ldx = sqrt(LIGHTS)/WIDTH/2.0;
+  double ldy = sqrt(LIGHTS)/HEIGHT/2.0;
+  for (int i = 0; i < config.boxes; i++)
+    world->NewBox(config.boxType, config.boxSize,
+                  WIDTH * (3/8.0) + world->scenarioRng.Uniform() * WIDTH * 0.25 + ldx,
+                  HEIGHT * (3/8.0) + world->scenarioRng.Uniform() * HEIGHT * 0.25 + ldy,
+                  world->scenarioRng.Uniform() * M_PI);
+
+  for (int i = 0; i < config.robots; i++)
+  {
+    double x = WIDTH / 2.0;
+    double y = HEIGHT / 2.0;
+
+    // Zoomed In
+    // while (x > WIDTH * 0.2 && x < WIDTH * 0.8 && y > HEIGHT * 0.2 && y < HEIGHT * 0.8)
+    // {
+    //   x = drand48() * WIDTH;
+    //   y = drand48() * HEIGHT;
+    // }
+
+    //Zoomed Out
+    double lhBoxBound = (WIDTH * 3/8.0);
+    double rhBoxBound= (WIDTH - lhBoxBound);
+    double bottomBoxBound = (HEIGHT * 3/8.0);
+    double topBoxBound = (HEIGHT - bottomBoxBound);
+    while ((x >= lhBoxBound && x <= rhBoxBound && y >= bottomBoxBound && y <= topBoxBound))
+    {
+      x = world->scenarioRng.Uniform() * (WIDTH * 4/8.0) + (WIDTH * 2/8.0);
+      y = world->scenarioRng.Uniform() * (HEIGHT * 4/8.0) + (HEIGHT * 2/8.0);
+    }
+
+    world->AddRobot(new Pusher(*world, config.robotType, config.robotSize, x + ldx, y + ldy, world->scenarioRng.Uniform() * M_PI));
+  }
+
+  // fill the world with a grid of lights, all off
+  // (width, height, height above arena, brightness)
+  world->AddLightGrid(sqrt(LIGHTS), sqrt(LIGHTS), 2.0, 0.0);
+
+  // Trade exact light integration for a bilinear lookup
+  if (config.lightFieldSubdivisions > 0)
+    world->EnableLightField(config.lightFieldSubdivisions);
+
+  world->SetWorkerThreads(config.threads);
+  world->b2world->SetWideContactSolver(config.wideContacts);
+  world->SetSettling(config.settleImpulse);
+  if (config.profileFile != "")
+    world->EnableProfiler();
+
+  // Read the polygon from the input file if we have one
+  if (config.polygonFile != "")
+  {
+    std::ifstream infile(config.polygonFile);
+    if (!world->loadPolygonFromFile(infile))
+    {
+      printf("The input file was invalid or did not define a polygon\n.");
+      return false;
+    }
+  }
+
+  // This is the center of the contracting shape
+  goalx = ceil((WIDTH)/2.0);
+  goaly = ceil((HEIGHT)/2.0);
+
+  // These lines prime the polygon
+  if (world->havePolygon)
+  {
+    // Make the centroid the origin
+    Vertex centroid = world->polygon->getCentroid();
+    world->polygon->translate(-1*centroid.x, -1*centroid.y, false);
+
+    // Move the polygon into the arena's coordinate system, with (0,0) in the bottom left
+    world->polygon->translate(goalx, goaly, true);
+  }
+
+  double lside = sqrt(LIGHTS);
+  double lx = WIDTH / lside; // distance between lights
+  double ly = HEIGHT / lside;
+
+  // The thickness of the contracting pattern
+  // No real intelligence here, but wider bands are a little more unwieldy
+  pattWidth = fmax(lx,ly)/10;
+
+  // Note that we don't want the center of the
+  // ring perimeter to actually hit the wall.
+  radMax = (WIDTH / 2.0) * (0.75);
+
+  // Set RAD-Min by matching the desired area (implicitly defined)
+  const double box_size = config.boxSize;
+  double boxArea;
+  if (config.boxType == Box::SHAPE_RECT)
+    boxArea = box_size*box_size;
+  else if (config.boxType == Box::SHAPE_CIRC)
+    boxArea = M_PI*((box_size/2)*(box_size/2));
+  else // box_type = HEX
+  {
+    //double perimeter = 6*(box_size/2);
+    double apothem = sqrt((box_size/2)*(box_size/2) - (box_size/4)*(box_size/4));
+    boxArea = (apothem * (box_size/4.0)) * 6.0;
+  }
+
+  // Also use this to make contraction a little more exact
+  const double robot_size = config.robotSize;
+  double robotArea;
+  if (config.robotType == Robot::SHAPE_RECT)
+    robotArea = robot_size*robot_size;
+  //else if (robot_type == Robot::SHAPE_CIRC)
+   // robotArea = M_PI*((robot_size/2)*(robot_size/2));
+  else // robot_size = HEX
+  {
+    //double perimeter = 6*(robot_size/2);
+    double apothem = sqrt((robot_size/2)*(robot_size/2) - (robot_size/4)*(robot_size/4));
+    robotArea = (apothem * (robot_size/4.0)) * 6.0;
+  }
+
+  if (config.verbose)
+  {
+    fprintf(stderr, "Initializing.");
+    printf("\nNumber of goals: %i\n", (int)world->numGoals);
+  }
+  //world->populateGoals(RADMIN);
+
+  // This gets the goal polygon center dead on with
+  // the center of convergence; important for measuring success
+  if (world->havePolygon)
+  {
+    world->populateGoalPolygon(boxArea, robotArea, robot_size, world->polygon);
+    world->centerGoalPolygonAgainstLights();
+  }
+
+  // Must do this after populating goals
+  if (config.outputFile != "")
+  {
+    world->saveWorldHeader(config.outputFile);
+    world->saveGoalsToFile(config.outputFile);
+    world->savePerformanceFileHeader(config.performanceFile, config.outputFile, config.maxSteps);
+  }
+
+  // These lines prime the polygon
+  if (world->havePolygon && config.flare > 0)
+  {
+    // Adjust the polygon to account for corners
+    // Note that we need to be centered around the origin
+    world->polygon->translate(-goalx, -goaly, true);
+    world->polygon->primeCorners(config.flare);
+    world->polygon->translate(goalx, goaly, true);
+  }
+
+  radMin = world->GetRadMin(boxArea, robotArea, robot_size, world->polygon);
+
+  // We need to adjust the user polygon to fit the arena
+  radius = radMax;
+  if (world->havePolygon)
+  {
+    world->polygon->markConcavePoints();
+    radMax = world->GetSetRadMax(world->polygon);
+    radius = world->polygon->getDistFromPoint(goalx, goaly);
+  }
+
+  circleRadMax = (WIDTH / 2.0) * 0.75;
+
+  goalRadCircle = sqrt((world->boxes.size()*boxArea)/M_PI);
+  if (!world->havePolygon)
+    world->minimumRad = goalRadCircle;
+
+  return true;
+}
+
+bool Simulation::UpdatePattern()
+{
+  const double drag = config.drag;
+
+  // Are we staying contracted?
+  if (holdFor != 0 && holdAtMin)
+  {
+    // Don't change radius
+    world->UpdateLightPattern(goalx, goaly, 1, radius, pattWidth, drag);
+    holdFor--;
+    // If we are done contracting, we need to grow above RadMin threshold
+    if (holdFor == 0)
+    {
+      if (world->havePolygon)
+        while(radius < radMin)
+        {
+          world->polygon->scale(sdelta);
+          radius *= sdelta;
+        }
+      else
+        radius += delta;
+    }
+  }
+  else // We aren't staying contracted
+  {
+    if (radius < radMin)
+    {
+      //delta = -delta; // * 2.0;
+      sdelta = 2-sdelta; // Switch to expansion
+
+      //xdelta = 0.1;
+      if (holdAtMin)
+        // Trial and error: this is a decent heuristic
+        holdFor = holdTime;
+      return false;
+    }
+
+    else if (((radius > radMax) && world->usePolygon) || (radius > circleRadMax && !world->usePolygon))
+      sdelta = 2-sdelta; // Switch to contraction
+      //delta = -delta; //downdelta;
+
+    // This shouldn't be an else despite the above
+    if (((radius <= radMax) && world->usePolygon) || (radius <= circleRadMax && !world->usePolygon))
+    {
+      if (world->havePolygon && config.switchToCircle) // proxy to determine if a polygon was supplied
+      {
+        // These switch between circle and polygon
+        // Can opt to use e.g. 0.25 instead of 0.5 to make switching radius tighter
+        if (radius > config.width/8.0 && world->usePolygon && sdelta > 1)
+        {
+          world->usePolygon = false;
+          radius = world->polygon->getDistFromPoint(world->polygon->cx, world->polygon->cy);
+        }
+        else if (radius < config.width/8.0 && !world->usePolygon && sdelta < 1)
+        {
+          world->usePolygon = true;
+          radius = world->polygon->getDistFromPoint(world->polygon->cx, world->polygon->cy);
+        }
+      }
+      // Turns all necessary lights on for a specific amount of contraction (radius)
+      // The polygon will automatically be used if it is well defined
+      if (drag != 0)
+        world->UpdateLightPattern(goalx, goaly, 1, radius, pattWidth, drag);
+      else
+        world->UpdateLightPattern(goalx, goaly, 1, radius, pattWidth, 0);
+    }
+
+    // This handles both contractions and dilation
+    if (holdFor == 0) // If we aren't staying contracted
+    {
+      if (world->havePolygon && world->usePolygon)
+        world->polygon->scale(sdelta);
+      radius *= sdelta;
+    }
+
+    // Optionally move the collected resources
+    // goalx += xdelta;
+    // goaly += ydelta;
+  }
+  return true;
+}
+
+double Simulation::Run()
+{
+  /* Loop until the user closes the window */
+  // Note that for irregular polygons we define the radius as the shortest distance
+  // to any point on the polygon
+  int writeState = config.guiTime;
+  if (config.verbose)
+    fprintf(stderr, "\nRunning...");
+  while (!world->RequestShutdown() && world->steps < config.maxSteps)
+  {
+    b2Timer timer;
+
+    // Going below the minimum radius changes direction without stepping
+    if (world->steps % UPDATE_RATE == 1) // every now and again
+    {
+      const bool stepping = UpdatePattern();
+      world->Profile(StepProfiler::PATTERN, timer);
+      if (!stepping)
+        continue;
+    }
+
+    if (--writeState == 0)
+    {
+      world->appendWorldStateToFile(config.outputFile);
+      writeState = config.guiTime;
+      world->Profile(StepProfiler::REPLAY, timer);
+    }
+
+    if (world->steps % (UPDATE_RATE*10) == 1) // We do not need to do this very frequently
+    {
+      if (world->numGoals > 0 && config.verbose)
+        printf("%ld steps: %f%% goals filled.\n", world->steps, world->evaluateSuccessNumGoals() * 100);
+      double successRate = world->evaluateSuccessInsidePoly(goalRadCircle, config.performanceFile);
+      if (config.verbose)
+        printf("%ld steps: %f%% boxes correct.\n", world->steps, successRate * 100);
+      world->Profile(StepProfiler::EVALUATE, timer);
+    }
+
+    world->Step(config.timeStep);
+
+    if (config.profileFile != "" && config.profileInterval > 0 && world->steps % config.profileInterval == 0)
+      world->WriteProfile(config.profileFile);
+  }
+
+  if (config.verbose)
+    printf("\nCompleted %lu steps.\n", world->steps);
+  double successRate = world->evaluateSuccessInsidePoly(goalRadCircle, config.performanceFile);
+  if (config.outputFile != "")
+    world->saveSuccessMeasure(config.outputFile);
+  if (config.verbose)
+    printf("%f%% of the boxes are in the right position.\n", successRate * 100);
+
+  if (config.profileFile != "")
+    world->WriteProfile(config.profileFile);
+
+  // Everything is buffered until now
+  world->CloseOutputs();
+
+  return successRate;
+}
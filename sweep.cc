@@ -0,0 +1,165 @@
+#include "push.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+Sweep::Sweep(const RunConfig &base) : base(base)
+{
+  // -o gave "Results_Replays/<name>"; each run adds its number to the name
+  if (base.outputFile != "")
+    outputBase = base.outputFile.substr(std::string("Results_Replays/").size());
+  this->base.verbose = false;
+  this->base.threads = 1;
+  // Runs share the threads, so their timings would say little
+  this->base.profileFile = "";
+}
+
+// Sets the option @letter of @config from @value, as main would
+static bool SetOption(RunConfig &config, char letter, const std::string &value)
+{
+  switch (letter)
+  {
+  case 'r':
+    config.robots = atoi(value.c_str());
+    break;
+  case 'b':
+    config.boxes = atoi(value.c_str());
+    break;
+  case 'f':
+    config.flare = atof(value.c_str());
+    break;
+  case 'd':
+    config.drag = atof(value.c_str());
+    break;
+  case 'c':
+    config.switchToCircle = atof(value.c_str()) > 0;
+    break;
+  case 'p':
+    config.polygonFile = (value == "none") ? "" : value;
+    break;
+  case 'e':
+    config.seed = strtoull(value.c_str(), NULL, 10);
+    config.haveSeed = true;
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+bool Sweep::Load(const std::string &fileName)
+{
+  std::ifstream file(fileName);
+  if (!file)
+    return false;
+
+  // Every line multiplies the runs so far by its values
+  runs.assign(1, base);
+  std::string lineStr;
+  while (getline(file, lineStr))
+  {
+    std::istringstream line(lineStr);
+    std::string option, value;
+    if (!(line >> option) || option[0] == '#')
+      continue;
+    if (option.size() != 2 || option[0] != '-')
+    {
+      printf("Unknown sweep option %s\n", option.c_str());
+      return false;
+    }
+
+    std::vector<std::string> values;
+    while (line >> value)
+    {
+      // a..b is every integer from a to b
+      const size_t dots = value.find("..");
+      if (dots != std::string::npos)
+      {
+        const long first = atol(value.substr(0, dots).c_str());
+        const long last = atol(value.substr(dots + 2).c_str());
+        for (long i = first; i <= last; ++i)
+          values.push_back(std::to_string(i));
+      }
+      else
+        values.push_back(value);
+    }
+
+    std::vector<RunConfig> grown;
+    for (auto &run : runs)
+      for (auto &v : values)
+      {
+        grown.push_back(run);
+        if (!SetOption(grown.back(), option[1], v))
+        {
+          printf("Unknown sweep option %s\n", option.c_str());
+          return false;
+        }
+      }
+    runs.swap(grown);
+  }
+
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    if (outputBase == "")
+      continue;
+    const std::string name = outputBase + "_" + std::to_string(i);
+    runs[i].outputFile = "Results_Replays/" + name + ((runs[i].replayFormat == 'T') ? ".txt" : ".bin");
+    runs[i].performanceFile = "Results/" + name + "_PerfData.txt";
+  }
+  return true;
+}
+
+void Sweep::Run(size_t threads, const std::string &tableName)
+{
+  std::vector<double> success(runs.size(), NAN);
+
+  // Runs take different times, so each thread takes the next one when
+  // it finishes rather than a fixed share
+  WorkerPool pool(std::max((size_t)1, threads) - 1);
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> finished(0);
+  pool.Run(pool.Size(), [&](size_t, size_t) {
+    for (size_t i = next++; i < runs.size(); i = next++)
+    {
+      const RunConfig &config = runs[i];
+      World world(config.width, config.height, config.width * config.height, config.guiTime,
+                  config.flare, config.drag, config.switchToCircle, false);
+      Simulation simulation(&world, config);
+      if (simulation.Populate())
+        success[i] = simulation.Run();
+      printf("Run %lu (%lu/%lu done): %f%% boxes correct\n", (unsigned long)i,
+             (unsigned long)++finished, (unsigned long)runs.size(), success[i] * 100);
+    }
+  });
+
+  // One line per run, then the same settings averaged over their seeds
+  std::ofstream table(tableName);
+  table << "Run\tRobots\tBoxes\tFlare\tDrag\tSwitchToCircle\tPolygon\tSeed\tSuccess\n";
+  std::map<std::string, std::vector<double> > groups;
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    const RunConfig &r = runs[i];
+    std::ostringstream settings;
+    settings << r.robots << "\t" << r.boxes << "\t" << r.flare << "\t" << r.drag << "\t"
+             << r.switchToCircle << "\t" << (r.polygonFile == "" ? "none" : r.polygonFile);
+    table << i << "\t" << settings.str() << "\t" << r.seed << "\t" << success[i] << "\n";
+    groups[settings.str()].push_back(success[i]);
+  }
+
+  std::ofstream summary(tableName + ".summary");
+  summary << "Robots\tBoxes\tFlare\tDrag\tSwitchToCircle\tPolygon\tRuns\tMean\tMin\tMax\n";
+  for (auto &g : groups)
+  {
+    double total = 0;
+    for (auto s : g.second)
+      total += s;
+    summary << g.first << "\t" << g.second.size() << "\t" << total / g.second.size() << "\t"
+            << *std::min_element(g.second.begin(), g.second.end()) << "\t"
+            << *std::max_element(g.second.begin(), g.second.end()) << "\n";
+  }
+}
@@ -0,0 +1,203 @@
+#include "push.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The layout loadNextState reads: states end with '$', and each section
+// is a name piece and a body piece, both between '!'. The body's first
+// line is the rest of the '!' line, so it is skipped
+
+static const char *Find(const char *p, const char *end, char c)
+{
+  const char *found = (const char *)memchr(p, c, end - p);
+  return found ? found : end;
+}
+
+// Copies the next whitespace separated token into @token, moving @p past
+// it. The mapped file isn't terminated, so strtof can't be pointed at it
+static bool NextToken(const char *&p, const char *end, char *token, size_t tokenSize)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    ++p;
+  const char *start = p;
+  while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+    ++p;
+  const size_t n = p - start;
+  if (n == 0 || n >= tokenSize)
+    return false;
+  memcpy(token, start, n);
+  token[n] = '\0';
+  return true;
+}
+
+static bool ParseFloat(const char *&p, const char *end, float &value)
+{
+  char token[64], *stop;
+  if (!NextToken(p, end, token, sizeof(token)))
+    return false;
+  value = strtof(token, &stop);
+  return stop != token;
+}
+
+static bool ParseDouble(const char *&p, const char *end, double &value)
+{
+  char token[64], *stop;
+  if (!NextToken(p, end, token, sizeof(token)))
+    return false;
+  value = strtod(token, &stop);
+  return stop != token;
+}
+
+static bool ParseInt(const char *&p, const char *end, long &value)
+{
+  char token[32], *stop;
+  if (!NextToken(p, end, token, sizeof(token)))
+    return false;
+  value = strtol(token, &stop, 10);
+  return stop != token;
+}
+
+TextReplayReader::TextReplayReader(const std::string &fileName) : hasRobots(false),
+                                                                  hasBoxes(false),
+                                                                  hasLights(false),
+                                                                  hasGoals(false),
+                                                                  hasSuccess(false),
+                                                                  success(0),
+                                                                  data(NULL),
+                                                                  size(0),
+                                                                  next(NULL)
+{
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED)
+    {
+      data = (const char *)mapped;
+      size = st.st_size;
+      madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+  }
+  close(fd);
+  next = data;
+}
+
+TextReplayReader::~TextReplayReader()
+{
+  if (data)
+    munmap((void *)data, size);
+}
+
+bool TextReplayReader::NextState()
+{
+  hasRobots = hasBoxes = hasLights = hasGoals = hasSuccess = false;
+  if (!data || next >= data + size)
+    return false;
+
+  const char *end = Find(next, data + size, '$');
+  const char *p = next;
+  next = (end < data + size) ? end + 1 : end;
+
+  while (p < end)
+  {
+    const char *bang = Find(p, end, '!');
+    const char section = (bang - p >= 2) ? p[1] : '\0';
+    if (bang == end)
+      break;
+    p = bang + 1;
+    if (section == '\0' || !strchr("HRBLGS", section))
+      continue;
+
+    const char *bodyEnd = Find(p, end, '!');
+    const char *line = Find(p, bodyEnd, '\n');
+    p = (bodyEnd < end) ? bodyEnd + 1 : end;
+
+    // Containers are cleared rather than shrunk, so after the first few
+    // states they already have room for everything
+    switch (section)
+    {
+    case 'R':
+      hasRobots = true;
+      robots.clear();
+      break;
+    case 'B':
+      hasBoxes = true;
+      boxes.clear();
+      break;
+    case 'L':
+      hasLights = true;
+      lights.clear();
+      break;
+    case 'G':
+      hasGoals = true;
+      goals.clear();
+      break;
+    default:
+      break;
+    }
+
+    while (line < bodyEnd)
+    {
+      const char *start = line + 1;
+      line = Find(start, bodyEnd, '\n');
+      const char *q = start;
+      switch (section)
+      {
+      case 'R':
+      {
+        ReplayRobot r;
+        if (ParseFloat(q, line, r.x) && ParseFloat(q, line, r.y) && ParseFloat(q, line, r.a) && ParseFloat(q, line, r.charge))
+          robots.push_back(r);
+        break;
+      }
+      case 'B':
+      {
+        ReplayBox b;
+        long insidePoly;
+        if (ParseFloat(q, line, b.x) && ParseFloat(q, line, b.y) && ParseFloat(q, line, b.a) && ParseInt(q, line, insidePoly))
+        {
+          b.insidePoly = insidePoly != 0;
+          boxes.push_back(b);
+        }
+        break;
+      }
+      case 'L':
+      {
+        float index;
+        ReplayLight l;
+        if (ParseFloat(q, line, index) && ParseFloat(q, line, l.intensity) && index >= 0)
+        {
+          l.index = index;
+          lights.push_back(l);
+        }
+        break;
+      }
+      case 'G':
+      {
+        ReplayGoal g;
+        long shape;
+        if (ParseFloat(q, line, g.x) && ParseFloat(q, line, g.y) && ParseFloat(q, line, g.size) && ParseInt(q, line, shape))
+        {
+          g.shape = shape;
+          goals.push_back(g);
+        }
+        break;
+      }
+      case 'S':
+        if (ParseDouble(q, line, success))
+          hasSuccess = true;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return true;
+}
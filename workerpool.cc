@@ -0,0 +1,77 @@
+#include "push.hh"
+
+WorkerPool::WorkerPool(size_t threads) : job(NULL),
+                                         count(0),
+                                         generation(0),
+                                         pending(0),
+                                         stopping(false)
+{
+  // Slice 0 belongs to the caller of Run
+  for (size_t i = 0; i < threads; ++i)
+    this->threads.push_back(std::thread(&WorkerPool::Work, this, i + 1));
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &t : threads)
+    t.join();
+}
+
+void WorkerPool::Run(size_t count, const std::function<void(size_t, size_t)> &job)
+{
+  if (threads.empty() || count < 2)
+  {
+    job(0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    this->job = &job;
+    this->count = count;
+    pending = threads.size();
+    ++generation;
+  }
+  wake.notify_all();
+
+  job(0, count / Size());
+
+  std::unique_lock<std::mutex> guard(lock);
+  done.wait(guard, [this] { return pending == 0; });
+  this->job = NULL;
+}
+
+void WorkerPool::Work(size_t slice)
+{
+  size_t seen = 0;
+  for (;;)
+  {
+    const std::function<void(size_t, size_t)> *current;
+    size_t n;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wake.wait(guard, [this, seen] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+      current = job;
+      n = count;
+    }
+
+    const size_t begin = n * slice / Size();
+    const size_t end = n * (slice + 1) / Size();
+    if (begin < end)
+      (*current)(begin, end);
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      --pending;
+    }
+    done.notify_one();
+  }
+}
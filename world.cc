@@ -4,6 +4,10 @@
 #include <stdio.h>
 #include <string>
 #include <stdlib.h>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 World::World(double width, double height, int numLights, int drawInterval, double flare, double drag, bool switchToCircle, bool replayWorld) : steps(0),
                                                               width(width),
@@ -14,12 +18,26 @@ World::World(double width, double height, int numLights, int drawInterval, doubl
                                                               drag(drag),
                                                               switchToCircle(switchToCircle),
                                                               havePolygon(false),
+                                                              usePolygon(false),
                                                               b2world(new b2World(b2Vec2(0, 0))), // gravity
-                                                              lights()                            //empty vector
+                                                              lights(),                           //empty vector
+                                                              goals(width, height),
+                                                              lightField(NULL),
+                                                              replayFormat('T'),
+                                                              replayWriter(NULL),
+                                                              backgroundOutput(false),
+                                                              workers(NULL),
+                                                              settler(NULL),
+                                                              profiler(NULL),
+                                                              patternGeneration(0),
+                                                              paused(false),
+                                                              replayWorld(replayWorld),
+                                                              replay_paused(false),
+                                                              replay_seek(0)
 {
-  replayWorld = replayWorld;
-  replay_paused = false;
-  srand48(time(NULL));
+  lightWatchers.push_back(&fieldChanges);
+  lightWatchers.push_back(&replayChanges);
+  SetSeed(time(NULL));
   //set interior box container
   b2BodyDef boxWallDef;
   b2PolygonShape groundBox;
@@ -45,18 +63,7 @@ World::World(double width, double height, int numLights, int drawInterval, doubl
 
   success = -1;
 
-  // Populate the goals
   numGoals = 0;
-  for (int i = 0; i < width; ++i)
-  {
-    std::vector<std::vector<Goal*>> goalCol;
-    for (int j = 0; j < height; ++j)
-    {
-      std::vector<Goal*> goalList;
-      goalCol.push_back(goalList);
-    }
-    goals.push_back(goalCol);
-  }
 
   // Zoomed in
   // boxWall[0]->SetTransform(b2Vec2(width / 2, height / 4.0), 0);
@@ -96,9 +103,31 @@ World::World(double width, double height, int numLights, int drawInterval, doubl
   robotWall[3]->SetTransform(b2Vec2(width, height / 2), M_PI / 2.0);
 }
 
-void World::AddLight(Light *l)
+World::~World()
+{
+  CloseOutputs();
+  delete workers;
+  delete lightField;
+  delete settler;
+  delete profiler;
+
+  clearGoals();
+  for (auto &r : robots)
+    delete r;
+  for (auto &b : boxes)
+    boxPool.Delete(b);
+  delete polygon;
+  delete goalPolygon;
+
+  // Takes the walls and the robots' and boxes' bodies with it
+  delete b2world;
+}
+
+void World::AddLight(const Light &l)
 {
-  lights.push_back(l);
+  lights.Add(l);
+  for (auto &watcher : lightWatchers)
+    watcher->all = true;
 }
 
 void World::AddLightGrid(size_t xcount, size_t ycount, double z, double intensity)
@@ -108,10 +137,10 @@ void World::AddLightGrid(size_t xcount, size_t ycount, double z, double intensit
 
   for (size_t y = 0; y < ycount; y++)
     for (size_t x = 0; x < xcount; x++)
-      AddLight(new Light(x * xspace + xspace / 2.0,
-                         y * yspace + yspace / 2.0,
-                         z,
-                         intensity, x + y * xcount));
+      AddLight(Light(x * xspace + xspace / 2.0,
+                     y * yspace + yspace / 2.0,
+                     z,
+                     intensity, x + y * xcount));
 } // We assume that xcount=ycount above
 
 void World::AddRobot(Robot *r)
@@ -126,14 +155,61 @@ void World::AddBox(Box *b)
 
 void World::AddGoal(Goal *g)
 {
-  goals[floor(g->x)][floor(g->y)].push_back(g);
+  goals.Add(g);
   numGoals++;
 }
 
 void World::SetLightIntensity(size_t index, double intensity)
 {
-  if (index < lights.size())
-    lights[index]->intensity = intensity;
+  if (index < lights.size() && lights.intensity[index] != intensity)
+  {
+    lights.intensity[index] = intensity;
+    for (auto &watcher : lightWatchers)
+      watcher->Mark(index);
+  }
+}
+
+void LightChanges::Mark(size_t index)
+{
+  if (all)
+    return;
+  if (index >= marked.size())
+    marked.resize(index + 1, false);
+  if (!marked[index])
+  {
+    marked[index] = true;
+    indices.push_back(index);
+  }
+}
+
+void LightChanges::Clear()
+{
+  for (auto i : indices)
+    marked[i] = false;
+  indices.clear();
+  all = false;
+}
+
+void World::EnableLightField(int subdivisions)
+{
+  // The map relies on the square, evenly spaced grid from AddLightGrid
+  if (lights.size() == 0 || width != height)
+  {
+    fprintf(stderr, "Irradiance map needs a square light grid. Using exact light integration.\n");
+    return;
+  }
+  delete lightField;
+  lightField = new LightField(*this, subdivisions);
+  fieldChanges.Clear();
+}
+
+void World::SyncLightField()
+{
+  if (lightField && !fieldChanges.Empty())
+  {
+    lightField->Refresh(fieldChanges);
+    fieldChanges.Clear();
+  }
 }
 
 void World::UpdateLightPattern(double goalx, double goaly, double probOn, double radius, double PATTWIDTH, double cornerRate)
@@ -141,75 +217,142 @@ void World::UpdateLightPattern(double goalx, double goaly, double probOn, double
   double lside = sqrt(lights.size());
   double lx = width / lside;
   double ly = height / lside;
-  double r2 = radius * radius;
-  double randOn, cx, cy, c, c2;
-  double dist;
+  double randOn, cx, cy, c;
   std::vector<std::tuple<double, int>> lightsOn;
-  for (int x = 0; x < lside; x++)
-    for (int y = 0; y < lside; y++)
+
+  // Only lights near the ring (or outline) can turn on, so we visit those
+  // and the lights we turned on last time, rather than the whole grid.
+  // Anything lit before the first pattern counts as part of the pattern
+  if (patternStamp.size() != lights.size())
+  {
+    patternStamp.assign(lights.size(), 0);
+    patternLights.clear();
+    for (size_t i = 0; i < lights.size(); ++i)
+      if (lights.intensity[i] != 0)
+        patternLights.push_back(i);
+  }
+  ++patternGeneration;
+  std::vector<size_t> candidates;
+
+  const double bandwidth = fmax(fmax(lx,ly)/2,PATTWIDTH);
+
+  auto consider = [&](int x, int y)
+  {
+    int on = 0;
+    if (usePolygon) // Use the polygon
     {
-      int on = 0;
-      if (usePolygon) // Use the polygon
+      on = (polygon->getOutlineDist(x, y) < bandwidth);
+      if (on && drag != 0)
       {
-        on = (fabs(polygon->getDistFromPoint(x, y) < fmax(fmax(lx,ly)/2,PATTWIDTH)));
-        if (on && drag != 0)
-        {
-          double minDist = width*height;
-          for (auto vertex: polygon->vertices)
-          {
-            //if (vertex.userVert)
-            if (!vertex.concave)
-            {
-              // Use squared distance since we only care about order
-              dist = ((x - vertex.x) * (x - vertex.x)) + ((y - vertex.y) * (y - vertex.y));
-              if (dist < minDist)
-                minDist = dist;
-            }
-          }
-          std::tuple<double, int> lightTuple(minDist, x + y * lside);
-          lightsOn.push_back(lightTuple);
-        }
+        // Use squared distance since we only care about order
+        double minDist = polygon->getNearestConvexDistSq(x, y, width*height);
+        std::tuple<double, int> lightTuple(minDist, x + y * lside);
+        lightsOn.push_back(lightTuple);
       }
-      else // Use the circle
-      {
-        // (Number of lights between) * (distance between lights)
-        cx = (x - goalx) * lx;
-        cy = (y - goaly) * ly;
-
-        c = sqrt(cx * cx + cy * cy);
-
-        //c2 = cx * cx + cy * cy; // Square distance
-        // int on = (fabs(c2 - r2) < PATTWIDTH*PATTWIDTH);
+    }
+    else // Use the circle
+    {
+      // (Number of lights between) * (distance between lights)
+      cx = (x - goalx) * lx;
+      cy = (y - goaly) * ly;
 
-        // We turn the light on if the light is within the specified closeness
-        // or within 1 light away if this value is greater than the PATTWIDTH
+      c = sqrt(cx * cx + cy * cy);
 
-        on = (fabs(c - radius) < fmax(fmax(lx,ly)/2,PATTWIDTH));
-      }
+      // We turn the light on if the light is within the specified closeness
+      // or within 1 light away if this value is greater than the PATTWIDTH
+      on = (fabs(c - radius) < bandwidth);
+    }
 
-      randOn = ((double)rand() / (RAND_MAX));
+    // Note that if on == 0, we just turn the light off regardless of randOn
+    if (on && probOn < 1)
+    {
+      randOn = patternRng.Uniform();
+      on = (randOn <= probOn);
+    }
+    if (on)
+    {
       // Use 1D indexing
-      // Note that if on == 0, we just turn the light off regardless of randOn
-      SetLightIntensity(x + y * lside,
-                        on * (randOn <= probOn));
-      // (fabs( c2 - r2 ) < lside) ); Old version: Why is this lside?
+      size_t index = x + y * lside;
+      patternStamp[index] = patternGeneration;
+      candidates.push_back(index);
     }
-  
+  };
+
+  const int last = lside - 1;
+  if (usePolygon)
+  {
+    // Polygon distances are measured in light indices, like the loop
+    // variables. The raster only holds points inside the band
+    polygon->rasterizeOutline(lside, lside, bandwidth);
+    for (auto cell : polygon->getOutlineCells())
+      consider(cell % (int)lside, cell / (int)lside);
+  }
+  else
+  {
+    // Visit each row's span of the annulus, with a light of slack either
+    // side. The exact test above still decides what is on
+    double outer = radius + bandwidth;
+    double inner = radius - bandwidth;
+    int y0 = std::max(0.0, floor(goaly - outer / ly) - 1);
+    int y1 = std::min((double)last, ceil(goaly + outer / ly) + 1);
+    for (int y = y0; y <= y1; y++)
+    {
+      double dy = fabs(y - goaly) * ly;
+      double ox = outer > dy ? sqrt(outer * outer - dy * dy) / lx : 0;
+      double ix = inner > dy ? sqrt(inner * inner - dy * dy) / lx : 0;
+
+      int left0 = std::max(0.0, floor(goalx - ox) - 1);
+      int left1 = std::min((double)last, ceil(goalx - ix) + 1);
+      int right0 = std::max((double)left1 + 1, floor(goalx + ix) - 1);
+      int right1 = std::min((double)last, ceil(goalx + ox) + 1);
+      for (int x = left0; x <= left1; x++)
+        consider(x, y);
+      for (int x = right0; x <= right1; x++)
+        consider(x, y);
+    }
+  }
+
   // This lexicographically sorts the tuples by distance
   if (drag != 0)
   {
     std::sort(lightsOn.begin(), lightsOn.end());
-    double lightsTurnedOff = 0;
-    int i = 0;
-    while (lightsTurnedOff / lightsOn.size() < cornerRate || lightsTurnedOff / lightsOn.size() == 1.0)
+    size_t lightsTurnedOff = 0;
+    while (lightsTurnedOff < lightsOn.size() && (double)lightsTurnedOff / lightsOn.size() < cornerRate)
     {
-      SetLightIntensity(std::get<1>(lightsOn[lightsTurnedOff]), 0);
-      lightsTurnedOff += 1.0;
+      patternStamp[std::get<1>(lightsOn[lightsTurnedOff])] = 0;
+      ++lightsTurnedOff;
     }
   }
+
+  // Turn off whatever is no longer part of the pattern, then light the
+  // new pattern. SetLightIntensity only reports lights that really change
+  for (auto index : patternLights)
+    if (patternStamp[index] != patternGeneration)
+      SetLightIntensity(index, 0);
+
+  patternLights.clear();
+  for (auto index : candidates)
+    if (patternStamp[index] == patternGeneration)
+    {
+      SetLightIntensity(index, 1);
+      patternLights.push_back(index);
+    }
 }
 
-double World::GetLightIntensityAt(double x, double y)
+double World::GetLightIntensityAt(double x, double y, double *bound)
+{
+  if (lightField)
+  {
+    SyncLightField();
+    return lightField->Sample(x, y, bound);
+  }
+
+  if (bound)
+    *bound = 0;
+  return GetExactLightIntensityAt(x, y);
+}
+
+double World::GetExactLightIntensityAt(double x, double y)
 {
   // integrate brightness over all light sources
   double total_brightness = 0.0;
@@ -242,40 +385,162 @@ double World::GetLightIntensityAt(double x, double y)
 
       assert(index < lights.size());
 
-      auto &l = lights[index];
+      const double intensity = lights.intensity[index];
 
-      if (l->intensity == 0.0)
+      if (intensity == 0.0)
         continue;
 
       // horizontal and vertical distances
-      const double dx = x - l->x;
-      const double dy = y - l->y;
+      const double dx = x - lights.x[index];
+      const double dy = y - lights.y[index];
 
       if (fabs(dx) > maxdist || fabs(dy) > maxdist)
         continue;
 
-      const double dz = l->z;
+      const double dz = lights.z[index];
       const double distsquared = dx * dx + dy * dy + dz * dz;
       const double dist = sqrt(distsquared);
 
       // brightness as a function of distance
-      const double brightness = l->intensity / distsquared;
+      const double brightness = intensity / distsquared;
 
       // now factor in the angle to the light
       const double theta = atan2(dz, hypot(dx * dx, dy * dy));
 
       // and integrate
-      double noise = (drand48() - 0.5) * 0.00;
-      total_brightness += brightness * sin(theta) + noise;
+      total_brightness += brightness * sin(theta);
     }
 
   return total_brightness;
 }
 
+void World::GetLightIntensitiesAt(const double *x, const double *y, double *out, size_t count)
+{
+  // Sample only reads the map, so bring it up to date before splitting
+  SyncLightField();
+
+  auto job = [&](size_t begin, size_t end)
+  {
+    if (lightField)
+      for (size_t i = begin; i < end; ++i)
+        out[i] = lightField->Sample(x[i], y[i], NULL);
+    else
+      for (size_t i = begin; i < end; ++i)
+        out[i] = GetExactLightIntensityAt(x[i], y[i]);
+  };
+
+  if (workers)
+    workers->Run(count, job);
+  else
+    job(0, count);
+}
+
+void World::SetSeed(uint64_t seed)
+{
+  this->seed = seed;
+  scenarioRng.Seed(seed, Rng::STREAM_SCENARIO);
+  patternRng.Seed(seed, Rng::STREAM_PATTERN);
+}
+
+void World::SetWorkerThreads(size_t threads)
+{
+  b2world->SetTaskRunner(NULL);
+  delete workers;
+  workers = NULL;
+  if (threads > 1)
+  {
+    workers = new WorkerPool(threads - 1);
+    physicsTasks.pool = workers;
+    b2world->SetTaskRunner(&physicsTasks);
+  }
+}
+
+void World::SetSettling(double wakeImpulse)
+{
+  b2world->SetContactListener(NULL);
+  delete settler;
+  settler = NULL;
+  if (wakeImpulse > 0)
+  {
+    settler = new BoxSettler(wakeImpulse);
+    b2world->SetContactListener(settler);
+  }
+}
+
+void World::EnableProfiler()
+{
+  if (!profiler)
+    profiler = new StepProfiler();
+}
+
+void World::WriteProfile(const std::string &fileName)
+{
+  // The first call starts the file
+  const bool first = outputs.find(fileName) == outputs.end();
+  std::string table = profiler->Table(steps);
+  if (first)
+    table = StepProfiler::Header() + table;
+  Output(fileName, first).Write(table);
+}
+
+void World::SenseLights()
+{
+  // Nothing moves until b2world steps, so reading every sensor up front
+  // gives the same values as reading them one at a time in Update
+  sensorX.clear();
+  sensorY.clear();
+  for (auto &r : robots)
+  {
+    const b2Vec2 here = r->body->GetWorldCenter();
+    sensorX.push_back(here.x);
+    sensorY.push_back(here.y);
+
+    r->sensed.clear();
+    if (r->SensorsDue())
+      for (auto &s : r->sensors)
+      {
+        const b2Vec2 there = r->body->GetWorldPoint(s);
+        sensorX.push_back(there.x);
+        sensorY.push_back(there.y);
+        r->sensed.push_back(0);
+      }
+  }
+
+  sensorReadings.resize(sensorX.size());
+  if (!sensorX.empty())
+    GetLightIntensitiesAt(&sensorX[0], &sensorY[0], &sensorReadings[0], sensorX.size());
+
+  size_t next = 0;
+  for (auto &r : robots)
+  {
+    r->light = sensorReadings[next++];
+    for (auto &reading : r->sensed)
+      reading = sensorReadings[next++];
+  }
+}
+
 void World::Step(double timestep)
 {
+  b2Timer timer;
+  SenseLights();
+  Profile(StepProfiler::SENSE, timer);
+
+  // Controllers only change their own robot, and their motor commands
+  // wait until all of them have run, so the order doesn't matter
+  auto job = [this, timestep](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+      robots[i]->Update(timestep);
+  };
+
+  if (workers)
+    workers->Run(robots.size(), job);
+  else
+    job(0, robots.size());
+
   for (auto &r : robots)
-    r->Update(timestep);
+    r->ApplySpeed();
+  Profile(StepProfiler::CONTROL, timer);
 
   const int32 velocityIterations = 6;
   const int32 positionIterations = 2;
@@ -283,6 +548,15 @@ void World::Step(double timestep)
   // Instruct the world to perform a single step of simulation.
   // It is generally best to keep the time step and iterations fixed.
   b2world->Step(timestep, velocityIterations, positionIterations);
+  if (profiler)
+    profiler->AddPhysics(b2world->GetProfile());
+  Profile(StepProfiler::PHYSICS, timer);
+
+  if (settler)
+  {
+    settler->Update(boxes, timestep);
+    Profile(StepProfiler::SETTLE, timer);
+  }
 
   steps++;
 }
@@ -340,10 +614,35 @@ double World::GetSetRadMax(Polygon* tempPoly){
   return radMax;
 }
 
+BufferedFile &World::Output(const std::string &fileName, bool truncate)
+{
+  BufferedFile *&file = outputs[fileName];
+  if (truncate || !file)
+  {
+    delete file;
+    file = new BufferedFile(fileName, truncate, backgroundOutput);
+  }
+  return *file;
+}
+
+void World::FlushOutputs()
+{
+  for (auto &output : outputs)
+    output.second->Flush();
+}
+
+void World::CloseOutputs()
+{
+  delete replayWriter;
+  replayWriter = NULL;
+  for (auto &output : outputs)
+    delete output.second;
+  outputs.clear();
+}
+
 void World::saveWorldHeader(std::string saveFileName)
 {
-  std::ofstream outfile;
-  outfile.open(saveFileName);
+  std::ostringstream outfile;
 
   outfile << "HEADER:\n";
   outfile << "-w " << width << " -h " << height;
@@ -351,14 +650,33 @@ void World::saveWorldHeader(std::string saveFileName)
   outfile << " -z " << robots[0]->size << " -s " << boxes[0]->size;
   outfile << " -t " << robots[0]->cshape << " -y " << boxes[0]->cshape;
   outfile << " -f " << flare;
+  outfile << " -e " << seed;
+  if (replayFormat != 'T')
+    outfile << " -k " << replayFormat;
   outfile << " -g " << "1" << '\n';
   outfile << "$\n";
+
+  // The last writer finishes its file before Output can replace it
+  delete replayWriter;
+  replayWriter = NULL;
+  Output(saveFileName, true).Write(outfile.str());
+
+  // Binary records follow the same text header
+  if (replayFormat == 'B' || replayFormat == 'Q')
+    replayWriter = new ReplayWriter(Output(saveFileName), robots.size(), boxes.size(), lights.size());
+  if (replayFormat == 'Q')
+  {
+    double chargeMax = 0;
+    for (auto r : robots)
+      chargeMax = fmax(chargeMax, r->charge_max);
+    // One step is width / 65535, so poses are off by at most 1.5 steps
+    replayWriter->Quantise(width, height, chargeMax, 1);
+  }
 }
 
 void World::savePerformanceFileHeader(std::string saveFileName, std::string userFileName, uint64_t maxSteps)
 {
-  std::ofstream outfile;
-  outfile.open(saveFileName);
+  std::ostringstream outfile;
 
   outfile << saveFileName << "\n";
   outfile << "HEADER:\n";
@@ -396,49 +714,86 @@ void World::savePerformanceFileHeader(std::string saveFileName, std::string user
   }
   outfile << "Maxsteps: " << maxSteps;
   outfile << "\n$\n";
+  Output(saveFileName, true).Write(outfile.str());
 }
 
 void World::saveSuccessMeasure(std::string saveFileName)
 {
-  std::ofstream outfile;
-  outfile.open(saveFileName, std::ios_base::app);
+  if (replayWriter)
+  {
+    replayWriter->AppendSuccess(success);
+    replayWriter->Close();
+    Output(saveFileName).Flush();
+    return;
+  }
+
+  std::ostringstream outfile;
 
   outfile << "Success:\n";
   outfile << "!\n";
   outfile << success << '\n';
   outfile << "!\n";
   outfile << "$\n";
+  Output(saveFileName).Write(outfile.str());
+  Output(saveFileName).Flush();
 }
 
 void World::saveGoalsToFile(std::string saveFileName)
 {
-  std::ofstream outfile;
-  outfile.open(saveFileName, std::ios_base::app);
+  if (replayWriter)
+  {
+    std::vector<ReplayGoal> records;
+    for (auto g : goals.Sorted())
+      records.push_back({(float)g->x, (float)g->y, (float)g->size, g->shape});
+    replayWriter->AppendGoals(records);
+    Output(saveFileName).Flush();
+    return;
+  }
+
+  std::ostringstream outfile;
 
   outfile << "!\n"; // Write a delimeter
   outfile << "GOALS:\n" << "!\n";
-  for (auto &col: goals)
+  for (auto g : goals.Sorted())
   {
-    for (auto &row : col)
-    {
-      for (auto &g : row)
-      {
-        // x, y, a, charge
-        outfile << g->x << ' ' << g->y << ' ' << g->size << ' ' <<  g->shape << '\n';
-      }
-    }
+    // x, y, a, charge
+    outfile << g->x << ' ' << g->y << ' ' << g->size << ' ' <<  g->shape << '\n';
   }
 
   outfile << "!\n"; // Write a delimeter
+  Output(saveFileName).Write(outfile.str());
+  Output(saveFileName).Flush();
 }
 
 // Saves the world state to a JSON file
 void World::appendWorldStateToFile(std::string saveFileName)
 {
+  if (saveFileName == "")
+    return;
+
+  if (replayWriter)
+  {
+    std::vector<ReplayRobot> robotRecords;
+    for (auto bot : robots)
+    {
+      const b2Vec2 pose = bot->body->GetPosition();
+      robotRecords.push_back({pose.x, pose.y, bot->body->GetAngle(), (float)bot->charge});
+    }
+    std::vector<ReplayBox> boxRecords;
+    for (auto box : boxes)
+    {
+      const b2Vec2 pose = box->body->GetPosition();
+      boxRecords.push_back({pose.x, pose.y, box->body->GetAngle(), box->insidePoly});
+    }
+    // Only the lights that changed since the last frame are compared
+    replayWriter->AppendFrame(steps, robotRecords, boxRecords, lights.intensity, replayChanges);
+    replayChanges.Clear();
+    return;
+  }
+
   // Initial attempt using box2dJson
   // worldString = jsonWorld.writeToString(b2world);
-  std::ofstream outfile;
-  outfile.open(saveFileName, std::ios_base::app);
+  std::ostringstream outfile;
 
   // The goals don't change position!
   // We write them separately and only once
@@ -463,18 +818,25 @@ void World::appendWorldStateToFile(std::string saveFileName)
     }
   outfile << "!\n";
   // Write the light information
-  outfile << "LIGHTS:\n"  << "!\n";
-  for (auto light : lights)
-    {
-      if (light->intensity != 0)
+  // Skipped when no light changed since the last frame; a loaded
+  // replay keeps the lights it already has
+  if (!replayChanges.Empty())
+  {
+    outfile << "LIGHTS:\n"  << "!\n";
+    for (size_t i = 0; i < lights.size(); ++i)
       {
-        // x, y, a, intensity
-        outfile << light->index << ' ' << light->intensity << '\n';
+        if (lights.intensity[i] != 0)
+        {
+          // x, y, a, intensity
+          outfile << i << ' ' << lights.intensity[i] << '\n';
+        }
       }
-    }
+    outfile << "!\n";
+    replayChanges.Clear();
+  }
   // outfile << worldString; // Write the world state
-  outfile << "!\n";
   outfile << "$\n";
+  Output(saveFileName).Write(outfile.str());
 }
 
 // Takes a section of robots and updates the positions/charges in the world
@@ -530,8 +892,7 @@ void World::updateGoalsFromString(std::string &goalStr)
       continue;
     std::istringstream indexStr(goal);
     indexStr >> x >> y >> size >> shape;
-    goals[x][y].push_back(new Goal(this, x, y, size, (Goal::goal_shape_t)shape));
-    ++numGoals;
+    AddGoal(NewGoal(x, y, size, (Goal::goal_shape_t)shape));
   }
 }
 
@@ -548,7 +909,7 @@ void World::updateLightsFromString(std::string &lightStr)
     // Zero everything
     // We save a ton of space in the state file this way
     // since on average we can assume a light is off
-    lights[i]->intensity = 0;
+    SetLightIntensity(i, 0);
   }
   double xdex, ydex;
   while (getline(iss, light, '\n'))
@@ -655,6 +1016,81 @@ bool World::loadNextState(std::ifstream& file)
   return running;
 }
 
+void World::loadTextReplayState(TextReplayReader &replay)
+{
+  if (replay.hasRobots)
+    for (size_t i = 0; i < replay.robots.size() && i < robots.size(); ++i)
+    {
+      const ReplayRobot &r = replay.robots[i];
+      robots[i]->body->SetTransform(b2Vec2(r.x, r.y), r.a);
+      robots[i]->charge = r.charge;
+    }
+
+  if (replay.hasBoxes)
+    for (size_t i = 0; i < replay.boxes.size() && i < boxes.size(); ++i)
+    {
+      const ReplayBox &b = replay.boxes[i];
+      boxes[i]->body->SetTransform(b2Vec2(b.x, b.y), b.a);
+      boxes[i]->insidePoly = b.insidePoly;
+    }
+
+  if (replay.hasLights)
+  {
+    // Only the lit lights are listed
+    for (size_t i = 0; i < lights.size(); ++i)
+      SetLightIntensity(i, 0);
+    for (auto &l : replay.lights)
+      SetLightIntensity(l.index, l.intensity);
+  }
+
+  if (replay.hasGoals)
+    for (auto &g : replay.goals)
+    {
+      AddGoal(NewGoal(g.x, g.y, g.size, (Goal::goal_shape_t)g.shape));
+    }
+
+  if (replay.hasSuccess)
+    success = replay.success;
+}
+
+void World::loadReplayGoals(ReplayReader &replay)
+{
+  for (auto &g : replay.Goals())
+  {
+    AddGoal(NewGoal(g.x, g.y, g.size, (Goal::goal_shape_t)g.shape));
+  }
+}
+
+bool World::loadReplayFrame(ReplayReader &replay, size_t frame)
+{
+  if (frame >= replay.Frames() || replay.RobotCount() != robots.size() || replay.BoxCount() != boxes.size())
+  {
+    replay.GetSuccess(success);
+    return false;
+  }
+
+  const ReplayRobot *r = replay.Robots(frame);
+  for (size_t i = 0; i < robots.size(); ++i)
+  {
+    robots[i]->body->SetTransform(b2Vec2(r[i].x, r[i].y), r[i].a);
+    robots[i]->charge = r[i].charge;
+  }
+
+  const ReplayBox *b = replay.Boxes(frame);
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    boxes[i]->body->SetTransform(b2Vec2(b[i].x, b[i].y), b[i].a);
+    boxes[i]->insidePoly = b[i].insidePoly;
+  }
+
+  // SetLightIntensity ignores lights that don't change
+  const std::vector<float> &intensities = replay.Lights(frame);
+  for (size_t i = 0; i < intensities.size(); ++i)
+    SetLightIntensity(i, intensities[i]);
+
+  return true;
+}
+
 bool World::loadPolygonFromFile(std::ifstream& infile)
 {
   std::string line;
@@ -681,208 +1117,169 @@ bool World::loadPolygonFromFile(std::ifstream& infile)
   }
 }
 
-bool World::populateGoals(double RADMIN, int callNum, std::vector<Goal*>& tempGoals)
+// Packings already worked out, keyed by everything that decides them.
+// Sweep runs with the same polygon, box size and count share one
+struct HexPacking
+{
+  double scale;
+  std::vector<b2Vec2> centres;
+};
+static std::map<std::vector<double>, HexPacking> packingCache;
+static std::mutex packingMutex;
+
+// The centres of the hexagons that tile the goal shape grown by @scale,
+// row by row from the bottom. Stops at @limit. @centres may be NULL
+// when only the count is wanted, so no goals are made while searching
+size_t World::hexCentres(double RADMIN, double scale, size_t limit, std::vector<b2Vec2> *centres)
 {
-  // The recursive sections marked below by ** are pretty inefficient
-  // but are extremely general. They will pack as well as possible
-  // given the parameters we have been given. I think this is
-  // reasonable since we only call this function once.
-  fprintf(stderr, ".");
-
   // The below assumes we are packing hexagons
   double cx = ceil(width/2.0);
   double cy = ceil(height/2.0);
   double d = boxes[0]->size; // diameter
   double r = d/2.0; //radius
   double apothem = sqrt(d*d - r*r)/2.0;
-  double oneBoxArea = (apothem * (r/2.0)) * 6.0;
 
-  // bounding box
+  // bounding box of the grown shape
   double bbmaxx = -1 * std::numeric_limits<double>::infinity();
   double bbmaxy = -1 * std::numeric_limits<double>::infinity();
   double bbminx = std::numeric_limits<double>::infinity();
   double bbminy = std::numeric_limits<double>::infinity();
 
-  getBoundingBox(goalPolygon->vertices, bbmaxx, bbmaxy, bbminx, bbminy, RADMIN);
+  getBoundingBox(goalPolygon->vertices, bbmaxx, bbmaxy, bbminx, bbminy, RADMIN * scale);
+  if (havePolygon)
+  {
+    bbmaxx = goalPolygon->cx + (bbmaxx - goalPolygon->cx) * scale;
+    bbmaxy = goalPolygon->cy + (bbmaxy - goalPolygon->cy) * scale;
+    bbminx = goalPolygon->cx + (bbminx - goalPolygon->cx) * scale;
+    bbminy = goalPolygon->cy + (bbminy - goalPolygon->cy) * scale;
+  }
 
   bbminx += apothem;
   bbminy += r;
 
-  // This looks like a scary double for-loop but it's just
-  // iterating through the centers of the hexagons that tile the arena
-  // The i increment is how far up from hexagon center the next row of centers is
-  double j, i = 0;
-  int row;
-  bool finished = false;
-  for (i = bbminy; i < bbmaxy; i += (r + (r/2.0)))
+  // Rather than growing the polygon, each centre is shrunk back onto it
+  size_t count = 0;
+  int row = 0;
+  for (double i = bbminy; i < bbmaxy && count < limit; i += (r + (r/2.0)), ++row)
   {
-    // The j increment is the horizontal distance to the next center
-    if (row % 2 == 0)
-      j = bbminx;
-    else
-      j = bbminx - apothem;
-    for (; j < bbmaxx; j += 2*apothem)
+    // Every other row is shifted back half a hexagon
+    for (double j = (row % 2 == 0) ? bbminx : bbminx - apothem; j < bbmaxx && count < limit; j += 2*apothem)
     {
+      bool inside;
       if (havePolygon) // User supplied a polygon
-      {
-        if (goalPolygon->pointInsidePoly(j, i))
-        {
-          tempGoals.push_back(new Goal(this, j, i, d, Goal::SHAPE_HEX));
-          if (tempGoals.size() == boxes.size())
-          {
-            // Limit this so we don't loop forever
-            if (goalPolygon->getArea() - tempGoals.size() * oneBoxArea > oneBoxArea && callNum != 20)
-            {
-              goalPolygon->scale(0.99);
-              tempGoals.clear();
-              populateGoals(RADMIN, callNum + 1, tempGoals); /**/
-              return true;
-            }
-            else
-              finished = true;
-          }
-        }
-      }
+        inside = goalPolygon->pointInsidePoly(goalPolygon->cx + (j - goalPolygon->cx) / scale,
+                                              goalPolygon->cy + (i - goalPolygon->cy) / scale);
       else // Goal is a circle
-      {
-        if (sqrt((cx-j)*(cx-j) + (cy-i)*(cy-i)) < RADMIN)
-        {
-          tempGoals.push_back(new Goal(this, j, i, d, Goal::SHAPE_HEX));
-          if (tempGoals.size()  == boxes.size())
-          {
-            // Limit this so we don't loop forever
-            if (M_PI*(RADMIN*RADMIN) - tempGoals.size() * oneBoxArea > oneBoxArea && callNum != 20)
-            {
-              // We underfilled. Try again
-              RADMIN *= 0.99;
-              tempGoals.clear();
-              populateGoals(RADMIN, callNum + 1, tempGoals); /**/
-              return true;
-            }
-            else
-              finished = true;
-          }
-        }
-      }
-      if (finished)
-        break;
+        inside = sqrt((cx-j)*(cx-j) + (cy-i)*(cy-i)) < RADMIN * scale;
+      if (!inside)
+        continue;
+      if (centres)
+        centres->push_back(b2Vec2(j, i));
+      ++count;
     }
-    if (finished)
-      break;
-    ++row;
   }
+  return count;
+}
+
+bool World::populateGoals(double RADMIN)
+{
+  const size_t wanted = boxes.size();
+  if (wanted == 0)
+    return false;
 
-  // We overfilled. Try again.
-  if (tempGoals.size() != boxes.size() && callNum < 20)
+  std::vector<double> key = {width, height, (double)numLights, (double)havePolygon, RADMIN, boxes[0]->size, (double)wanted};
+  if (havePolygon)
   {
-    if (havePolygon) // Polygon
+    key.push_back(goalPolygon->cx);
+    key.push_back(goalPolygon->cy);
+    for (auto &v : goalPolygon->vertices)
     {
-      goalPolygon->scale(1.00 + (rand() % 10)/100);
-      tempGoals.clear();
-      populateGoals(RADMIN, callNum + 1, tempGoals); /**/
-      return true;
+      key.push_back(v.x);
+      key.push_back(v.y);
     }
-    else // Circle
+  }
+
+  HexPacking packing;
+  bool cached;
+  {
+    std::lock_guard<std::mutex> lock(packingMutex);
+    auto found = packingCache.find(key);
+    cached = found != packingCache.end();
+    if (cached)
+      packing = found->second;
+  }
+
+  if (!cached)
+  {
+    // The count only grows with the scale (give or take a row), so
+    // bisect for the smallest scale that fits every box
+    double hi = 1, lo = 1;
+    for (int tries = 0; tries < 40 && hexCentres(RADMIN, hi, wanted, NULL) < wanted; ++tries)
+      hi *= 1.25;
+    for (int tries = 0; tries < 40 && hexCentres(RADMIN, lo, wanted, NULL) >= wanted; ++tries)
+      lo *= 0.8;
+    for (int steps = 0; steps < 30; ++steps)
     {
-      RADMIN *= 1.00 + (rand() % 10)/100;
-      tempGoals.clear();
-      populateGoals(RADMIN, callNum + 1, tempGoals); /**/
-      return true;
+      const double mid = (lo + hi) / 2.0;
+      if (hexCentres(RADMIN, mid, wanted, NULL) >= wanted)
+        hi = mid;
+      else
+        lo = mid;
     }
-  }
 
-  // We only make it here if we are finalizing
+    packing.scale = hi;
+    hexCentres(RADMIN, hi, wanted, &packing.centres);
 
-  // Matches the goals to the center of contraction
-  // Often this is a fractional value
-  recenterGoals(tempGoals);
+    // Matches the goals to the center of contraction
+    // Often this is a fractional value
+    recenterGoals(packing.centres);
 
-  // Ensures that the only goals we add are post adjustments
-  for (auto &g : tempGoals)
-  {
-    AddGoal(new Goal(this, g->x, g->y, g->size, g->shape));
+    std::lock_guard<std::mutex> lock(packingMutex);
+    packingCache[key] = packing;
   }
-  tempGoals.clear();
+
+  // The goal polygon is left at the scale the goals fill
+  if (havePolygon)
+    goalPolygon->scale(packing.scale);
+
+  // Only now are the goals made
+  for (auto &c : packing.centres)
+    AddGoal(NewGoal(c.x, c.y, boxes[0]->size, Goal::SHAPE_HEX));
 
   while (boxes.size() != numGoals)
   {
     // Equalize boxes and goals for fairness
+    b2world->DestroyBody(boxes.back()->body);
+    boxPool.Delete(boxes.back());
     boxes.pop_back();
   }
 
   return true;
 }
 
-  // Just clear all the innermost vectors
 void World::clearGoals()
 {
-  for (auto &col: goals)
-  {
-    for (auto &row : col)
-    {
-      row.clear();
-    }
-  }
+  for (auto g : goals.All())
+    DeleteGoal(g);
+  goals.Clear();
   numGoals = 0;
 }
 
 // Let's check how well we did
 double World::evaluateSuccessNumGoals()
 {
-  // This function is obsolete now
-  // The goal approach is extremely costlt
-  unfulfillGoals();
-
+  // Counts the most goals the boxes could fill at once, not the
+  // first come first served count, which could miss some
   double d = boxes[0]->size; // diameter
   double r = d/2.0; //radius
   double apothem = sqrt(d*d - r*r)/2.0;
-  double oneBoxArea = (apothem * (r/2.0)) * 6.0;
-  double numCorrect = 0;
-  double dist = 0;
-
-  bool gotSuccess = false;
 
-  double xmin,xmax,ymin,ymax;
+  std::vector<b2Vec2> positions;
+  positions.reserve(boxes.size());
   for (auto &box : boxes)
-  {
-    b2Vec2 pos = box->body->GetPosition();
-    xmax = floor(pos.x) + 1;
-    ymax = floor(pos.y) + 1;
-    xmin = floor(pos.x) - 1;
-    ymin = floor(pos.y) - 1;
-    for (int j = ymin; j <= ymax; ++j)
-    {
-      for (int i = xmin; i <= xmax; ++i)
-      {
-        for (int k = 0; k < goals[i][j].size(); ++k)
-        {
-          Goal* g = goals[i][j][k];
-          if (!g->fulfilled)
-          {
-            dist = sqrt((g->x - pos.x)*(g->x - pos.x) + (g->y - pos.y)*(g->y - pos.y));
-            if (dist <= apothem)
-            {
-              // At most one goal will be fulfilled by a box since goalSize = boxSize
-              numCorrect++;
-              g->fulfilled = true;
-              gotSuccess = true;
-            }
-          }
-          if (gotSuccess)
-            break;
-        }
-        if (gotSuccess)
-          break;
-      }
-      if (gotSuccess)
-        break;
-    }
-    if (gotSuccess)
-    {
-      gotSuccess = false;
-      continue;
-    }
-  }
+    positions.push_back(box->body->GetPosition());
+  double numCorrect = goals.Match(positions, apothem);
+
   // Capture the success so we can write it out later if need be
   success = numCorrect / numGoals;
   return numCorrect / numGoals;
@@ -891,10 +1288,9 @@ double World::evaluateSuccessNumGoals()
 // Let's check how well we did
 double World::evaluateSuccessInsidePoly(double MINRAD, std::string perfFile)
 {
-  std::ofstream outfile;
+  std::ostringstream outfile;
   if (perfFile != "")
   {
-    outfile.open(perfFile, std::ios_base::app);
     outfile << "!\n";
     outfile << "Step#: " << steps << "\n!" << "\n";
   }
@@ -982,11 +1378,15 @@ double World::evaluateSuccessInsidePoly(double MINRAD, std::string perfFile)
     outfile << "OutsideAverageDistance: " << outsideDist / numIncorrect << "\n";
     outfile << "!\n"; // End section
     outfile << "$\n"; // End step
+
+    // A good point to get everything so far out of memory
+    Output(perfFile).Write(outfile.str());
+    FlushOutputs();
   }
   return success;
 }
 
-void World::recenterGoals(std::vector<Goal*>& tempGoals)
+void World::recenterGoals(std::vector<b2Vec2>& centres)
 {
   double ldx = sqrt(numLights)/width/2.0;
   double ldy = sqrt(numLights)/height/2.0;
@@ -1005,26 +1405,25 @@ void World::recenterGoals(std::vector<Goal*>& tempGoals)
   double bbminy = std::numeric_limits<double>::infinity();
 
   double size = 0;
-  for (auto &g: tempGoals)
+  for (auto &g: centres)
   {
-    if (g->x > bbmaxx)
-      bbmaxx = g->x;
-    if (g->y > bbmaxy)
-      bbmaxy = g->y;
-    if (g->x < bbminx)
-      bbminx = g->x;
-    if (g->y < bbminy)
-      bbminy = g->y;
+    if (g.x > bbmaxx)
+      bbmaxx = g.x;
+    if (g.y > bbmaxy)
+      bbmaxy = g.y;
+    if (g.x < bbminx)
+      bbminx = g.x;
+    if (g.y < bbminy)
+      bbminy = g.y;
   }
 
   // Adjust to match the center of contraction for the lights
   double dx = trueCx - (bbmaxx+bbminx)/2.0;
   double dy = trueCy - (bbmaxy+bbminy)/2.0;
-  for (auto &g: tempGoals)
+  for (auto &g: centres)
   {
-    g->x += dx;
-    g->y += dy;
-    g->body->SetTransform(b2Vec2(g->x, g->y), 0);
+    g.x += dx;
+    g.y += dy;
   }
 }
 
@@ -1096,14 +1495,5 @@ void World::getBoundingBox(std::vector<T> vector, double& bbmaxx, double& bbmaxy
 // Used to reset on check
 void World::unfulfillGoals()
 {
-  for (auto &col: goals)
-  {
-    for (auto &row : col)
-    {
-      for (auto &g : row)
-      {
-        g->fulfilled = false;
-      }
-    }
-  }
+  goals.Unfulfill();
 }
\ No newline at end of file